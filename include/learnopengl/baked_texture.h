@@ -0,0 +1,308 @@
+#ifndef BAKED_TEXTURE_H
+#define BAKED_TEXTURE_H
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Container written by the texture_baker tool: every mip level of one image, already filtered offline and
+// optionally block compressed, so loading needs neither a JPEG/PNG decode nor glGenerateMipmap.
+// "<image>" is baked to "<image>.rgtex" and the container records the source's modification time and size;
+// a stale container is ignored by the loader. It also records how the levels were filtered and encoded, so the
+// baker can tell a container made with other settings from an up to date one.
+//
+// layout: Header, Header.levelCount x Level, then the pixel data of all levels, level 0 first
+enum BakedFormat : uint32_t {
+    BAKED_R8 = 1,
+    BAKED_RG8 = 2,
+    BAKED_RGB8 = 3,
+    BAKED_RGBA8 = 4,
+    // block compressed, 4x4 texel blocks
+    BAKED_BC1 = 16, // RGB, 8 bytes per block
+    BAKED_BC3 = 17, // RGBA, 16 bytes per block
+    BAKED_BC5 = 18  // two independent channels (RG), 16 bytes per block
+};
+
+struct BakedTexture {
+    struct Level {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset; // into data
+        uint64_t size;
+    };
+
+    // bake settings, see kernel and flags
+    enum Flags : uint32_t {
+        BAKE_SRGB = 1 << 0,      // levels filtered in linear light from sRGB texels
+        BAKE_WRAP = 1 << 1,      // filter kernels wrapped around the edges rather than clamped
+        BAKE_NORMAL_XY = 1 << 2  // a normal map stored as its X and Y only (BC5)
+    };
+
+    BakedFormat format = BAKED_RGBA8;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t kernel = 0;  // the baker's mip filter (MipKernel)
+    uint32_t flags = 0;
+    vector<Level> levels;
+    vector<unsigned char> data;
+
+    static const uint32_t MAGIC = 0x58544752; // "RGTX"
+    static const uint32_t VERSION = 2;
+
+    static string pathFor(const string &sourcePath)
+    {
+        return sourcePath + ".rgtex";
+    }
+
+    // channels the format holds once sampled, 0 for an unknown format
+    static unsigned int componentsOf(BakedFormat format)
+    {
+        switch (format)
+        {
+            case BAKED_R8: return 1;
+            case BAKED_RG8: case BAKED_BC5: return 2;
+            case BAKED_RGB8: case BAKED_BC1: return 3;
+            case BAKED_RGBA8: case BAKED_BC3: return 4;
+            default: return 0;
+        }
+    }
+
+    static bool isCompressed(BakedFormat format)
+    {
+        return format == BAKED_BC1 || format == BAKED_BC3 || format == BAKED_BC5;
+    }
+
+    static unsigned int blockBytes(BakedFormat format)
+    {
+        return format == BAKED_BC1 ? 8 : 16;
+    }
+
+    static const char* nameOf(BakedFormat format)
+    {
+        switch (format)
+        {
+            case BAKED_BC1: return "BC1";
+            case BAKED_BC3: return "BC3";
+            case BAKED_BC5: return "BC5";
+            default: return "uncompressed";
+        }
+    }
+
+    // bytes one level of the given size occupies in the container
+    static uint64_t levelSize(BakedFormat format, uint32_t width, uint32_t height)
+    {
+        if (isCompressed(format))
+            return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+        return (uint64_t)width * height * componentsOf(format);
+    }
+
+    // bytes all levels would take as plain 8-bit texels, for reporting what compression saved
+    uint64_t uncompressedSize() const
+    {
+        uint64_t total = 0;
+        for (const Level &level : levels)
+            total += (uint64_t)level.width * level.height * componentsOf(format);
+        return total;
+    }
+
+    // whether a block compressed level of this height can be flipped: block row by block row only works while
+    // the height is a multiple of 4 or the level is a single block row
+    static bool canFlipBlocks(uint32_t height)
+    {
+        return height % 4 == 0 || height <= 4;
+    }
+
+    // the same for every level of a full mip chain starting at height, each level half as tall as the last
+    static bool canFlipBlockChain(uint32_t height)
+    {
+        for (; height > 1; height /= 2)
+            if (!canFlipBlocks(height))
+                return false;
+        return true;
+    }
+
+    // flips every level upside down in place, see canFlipBlocks for block compressed levels; returns false and
+    // leaves the data partially flipped when a level can't be, the caller should fall back to the source image.
+    bool flipVertically()
+    {
+        for (const Level &level : levels)
+        {
+            unsigned char *pixels = data.data() + level.offset;
+            if (!isCompressed(format))
+            {
+                flipRows(pixels, (size_t)level.width * componentsOf(format), level.height);
+                continue;
+            }
+            if (!canFlipBlocks(level.height))
+                return false;
+            size_t blockRowSize = (size_t)((level.width + 3) / 4) * blockBytes(format);
+            uint32_t blockRows = (level.height + 3) / 4;
+            flipRows(pixels, blockRowSize, blockRows);
+            unsigned int rows = level.height < 4 ? level.height : 4;
+            for (size_t block = 0; block < level.size / blockBytes(format); block++)
+                flipBlock(pixels + block * blockBytes(format), rows);
+        }
+        return true;
+    }
+
+    const unsigned char* levelData(size_t level) const
+    {
+        return data.data() + levels[level].offset;
+    }
+
+    // reads the container baked from sourcePath, fails when it is missing, corrupt or older than the source
+    static bool load(const string &sourcePath, BakedTexture &texture)
+    {
+        struct stat source;
+        if (stat(sourcePath.c_str(), &source) != 0)
+            return false;
+
+        ifstream in(pathFor(sourcePath), ios::binary);
+        if (!in)
+            return false;
+        Header header;
+        if (!in.read((char*)&header, sizeof(header)) || header.magic != MAGIC || header.version != VERSION
+            || header.sourceMtime != mtimeOf(source) || header.sourceSize != (uint64_t)source.st_size
+            || header.levelCount == 0 || header.levelCount > 32)
+            return false;
+
+        texture.format = (BakedFormat)header.format;
+        if (componentsOf(texture.format) == 0)
+            return false;
+        texture.width = header.width;
+        texture.height = header.height;
+        texture.kernel = header.kernel;
+        texture.flags = header.flags;
+        texture.levels.resize(header.levelCount);
+        if (!in.read((char*)texture.levels.data(), texture.levels.size() * sizeof(Level)))
+            return false;
+        const Level &last = texture.levels.back();
+        uint64_t dataSize = last.offset + last.size;
+        if (dataSize != header.dataSize)
+            return false;
+        for (const Level &level : texture.levels)
+            if (level.offset + level.size > dataSize || level.size != levelSize(texture.format, level.width, level.height))
+                return false;
+        texture.data.resize(dataSize);
+        return (bool)in.read((char*)texture.data.data(), dataSize);
+    }
+
+    bool store(const string &sourcePath) const
+    {
+        struct stat source;
+        if (stat(sourcePath.c_str(), &source) != 0)
+            return false;
+
+        Header header;
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.format = format;
+        header.width = width;
+        header.height = height;
+        header.levelCount = (uint32_t)levels.size();
+        header.kernel = kernel;
+        header.flags = flags;
+        header.sourceMtime = mtimeOf(source);
+        header.sourceSize = (uint64_t)source.st_size;
+        header.dataSize = data.size();
+
+        string target = pathFor(sourcePath);
+        string temporary = target + ".tmp";
+        {
+            ofstream out(temporary, ios::binary | ios::trunc);
+            out.write((const char*)&header, sizeof(header));
+            out.write((const char*)levels.data(), levels.size() * sizeof(Level));
+            out.write((const char*)data.data(), data.size());
+            if (!out)
+            {
+                out.close();
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+        return std::rename(temporary.c_str(), target.c_str()) == 0;
+    }
+
+private:
+    static void flipRows(unsigned char *pixels, size_t rowSize, uint32_t rowCount)
+    {
+        vector<unsigned char> row(rowSize);
+        for (uint32_t top = 0, bottom = rowCount - 1; rowCount > 0 && top < bottom; top++, bottom--)
+        {
+            memcpy(row.data(), pixels + top * rowSize, rowSize);
+            memcpy(pixels + top * rowSize, pixels + bottom * rowSize, rowSize);
+            memcpy(pixels + bottom * rowSize, row.data(), rowSize);
+        }
+    }
+
+    // BC1 colour indices: one byte per texel row
+    static void flipColourIndices(unsigned char *indices, unsigned int rows)
+    {
+        for (unsigned int top = 0, bottom = rows - 1; top < bottom; top++, bottom--)
+            std::swap(indices[top], indices[bottom]);
+    }
+
+    // BC4 style single channel indices: 48 bits, 12 per texel row
+    static void flipChannelIndices(unsigned char *indices, unsigned int rows)
+    {
+        uint64_t bits = 0;
+        for (int i = 0; i < 6; i++)
+            bits |= (uint64_t)indices[i] << (8 * i);
+        uint64_t flipped = bits;
+        for (unsigned int row = 0; row < rows; row++)
+        {
+            uint64_t source = (bits >> (12 * row)) & 0xfff;
+            unsigned int target = rows - 1 - row;
+            flipped = (flipped & ~(0xfffULL << (12 * target))) | (source << (12 * target));
+        }
+        for (int i = 0; i < 6; i++)
+            indices[i] = (unsigned char)(flipped >> (8 * i));
+    }
+
+    void flipBlock(unsigned char *block, unsigned int rows) const
+    {
+        switch (format)
+        {
+            case BAKED_BC1:
+                flipColourIndices(block + 4, rows);
+                break;
+            case BAKED_BC3:
+                flipChannelIndices(block + 2, rows);
+                flipColourIndices(block + 12, rows);
+                break;
+            case BAKED_BC5:
+                flipChannelIndices(block + 2, rows);
+                flipChannelIndices(block + 10, rows);
+                break;
+            default:
+                break;
+        }
+    }
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+        uint32_t kernel;
+        uint32_t flags;
+        int64_t  sourceMtime;
+        uint64_t sourceSize;
+        uint64_t dataSize;
+    };
+
+    static int64_t mtimeOf(const struct stat &st)
+    {
+        return (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    }
+};
+#endif
@@ -0,0 +1,454 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Dynamic bounding volume hierarchy of axis-aligned boxes, for culling and picking over more objects than a flat
+// loop handles. Objects are inserted as proxies whose ids stay valid until they are removed. Each leaf stores its
+// box enlarged by a margin, so an object moving within it costs nothing. A move outside the margin refits the
+// leaf's ancestors bottom up in place, and only a jump that leaves the old box entirely reinserts the leaf.
+// Insertion picks the sibling with the least surface area growth, and rotations keep the tree height balanced
+// (like AVL trees), so queries visit O(log n) nodes plus the ones they report.
+//
+// Queries call a visitor per leaf. They share one traversal stack, so one tree must not be queried from several
+// threads at once.
+class DynamicBVH
+{
+public:
+    static const int NONE = -1;
+
+    struct Stats {
+        size_t refits = 0;      // moves absorbed by refitting the ancestors
+        size_t reinserts = 0;   // moves that reinserted the leaf
+    };
+
+    explicit DynamicBVH(float margin = 0.1f) : margin(margin)
+    {
+    }
+
+    // adds an object with the given world space box, returns its proxy id
+    int insert(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        int leaf = allocate();
+        nodes[leaf].boundsMin = boundsMin - glm::vec3(margin);
+        nodes[leaf].boundsMax = boundsMax + glm::vec3(margin);
+        nodes[leaf].height = 0;
+        insertLeaf(leaf);
+        leafCount++;
+        return leaf;
+    }
+
+    void remove(int proxy)
+    {
+        removeLeaf(proxy);
+        release(proxy);
+        leafCount--;
+    }
+
+    // new bounds of a moved object; returns whether the tree changed
+    bool update(int proxy, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        Node &leaf = nodes[proxy];
+        if (contains(leaf.boundsMin, leaf.boundsMax, boundsMin, boundsMax))
+            return false;
+        glm::vec3 fatMin = boundsMin - glm::vec3(margin);
+        glm::vec3 fatMax = boundsMax + glm::vec3(margin);
+        if (overlaps(leaf.boundsMin, leaf.boundsMax, fatMin, fatMax))
+        {
+            leaf.boundsMin = fatMin;
+            leaf.boundsMax = fatMax;
+            refit(leaf.parent);
+            counters.refits++;
+            return true;
+        }
+        removeLeaf(proxy);
+        nodes[proxy].boundsMin = fatMin;
+        nodes[proxy].boundsMax = fatMax;
+        insertLeaf(proxy);
+        counters.reinserts++;
+        return true;
+    }
+
+    // the enlarged box stored for proxy
+    void bounds(int proxy, glm::vec3 &boundsMin, glm::vec3 &boundsMax) const
+    {
+        boundsMin = nodes[proxy].boundsMin;
+        boundsMax = nodes[proxy].boundsMax;
+    }
+
+    size_t size() const
+    {
+        return leafCount;
+    }
+
+    // edges on the longest path from the root to a leaf, 0 for one object
+    int height() const
+    {
+        return root == NONE ? 0 : nodes[root].height;
+    }
+
+    const Stats &stats() const
+    {
+        return counters;
+    }
+
+    // visit(proxy) for every object whose box overlaps the given one
+    template <typename Visitor>
+    void queryBox(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, Visitor &&visit) const
+    {
+        if (root == NONE)
+            return;
+        stack.clear();
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            int index = stack.back();
+            stack.pop_back();
+            const Node &node = nodes[index];
+            if (!overlaps(node.boundsMin, node.boundsMax, boundsMin, boundsMax))
+                continue;
+            if (node.isLeaf())
+            {
+                visit(index);
+                continue;
+            }
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+
+    // visit(proxy) for every object whose box is at least partly inside the frustum. Below a node that lies
+    // entirely inside, the leaves are reported without further plane tests.
+    template <typename Visitor>
+    void queryFrustum(const Frustum &frustum, Visitor &&visit) const
+    {
+        if (root == NONE)
+            return;
+        // entries are node indices, negated and offset by one for nodes known to be inside
+        stack.clear();
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            int entry = stack.back();
+            stack.pop_back();
+            bool inside = entry < 0;
+            int index = inside ? -entry - 1 : entry;
+            const Node &node = nodes[index];
+            if (!inside)
+            {
+                Containment containment = classify(frustum, node.boundsMin, node.boundsMax);
+                if (containment == OUTSIDE)
+                    continue;
+                inside = containment == INSIDE;
+            }
+            if (node.isLeaf())
+            {
+                visit(index);
+                continue;
+            }
+            stack.push_back(inside ? -node.child1 - 1 : node.child1);
+            stack.push_back(inside ? -node.child2 - 1 : node.child2);
+        }
+    }
+
+    // visit(proxy, distance) for the objects whose box the ray from origin along direction enters within
+    // maxDistance, distance being where it enters, in units of direction's length. The visitor returns the
+    // distance to keep searching up to: maxDistance to see every box, or its own hit distance to find the
+    // closest hit.
+    template <typename Visitor>
+    void queryRay(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, Visitor &&visit) const
+    {
+        if (root == NONE)
+            return;
+        glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+        stack.clear();
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            int index = stack.back();
+            stack.pop_back();
+            const Node &node = nodes[index];
+            float entry;
+            if (!rayHits(origin, inverse, maxDistance, node.boundsMin, node.boundsMax, entry))
+                continue;
+            if (node.isLeaf())
+            {
+                maxDistance = std::min(maxDistance, visit(index, entry));
+                continue;
+            }
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+
+private:
+    enum Containment { OUTSIDE, INTERSECTING, INSIDE };
+
+    struct Node {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        int parent;   // next free node while on the free list
+        int child1;
+        int child2;
+        int height;   // 0 for leaves, -1 for free nodes
+
+        bool isLeaf() const
+        {
+            return child1 == NONE;
+        }
+    };
+
+    float margin;
+    std::vector<Node> nodes;
+    int root = NONE;
+    int freeList = NONE;
+    size_t leafCount = 0;
+    Stats counters;
+    mutable std::vector<int> stack;
+
+    int allocate()
+    {
+        int index;
+        if (freeList != NONE)
+        {
+            index = freeList;
+            freeList = nodes[index].parent;
+        }
+        else
+        {
+            index = (int)nodes.size();
+            nodes.push_back(Node());
+        }
+        nodes[index].parent = nodes[index].child1 = nodes[index].child2 = NONE;
+        nodes[index].height = 0;
+        return index;
+    }
+
+    void release(int index)
+    {
+        nodes[index].parent = freeList;
+        nodes[index].height = -1;
+        freeList = index;
+    }
+
+    static bool overlaps(const glm::vec3 &aMin, const glm::vec3 &aMax, const glm::vec3 &bMin, const glm::vec3 &bMax)
+    {
+        return aMin.x <= bMax.x && bMin.x <= aMax.x && aMin.y <= bMax.y && bMin.y <= aMax.y && aMin.z <= bMax.z
+               && bMin.z <= aMax.z;
+    }
+
+    static bool contains(const glm::vec3 &outerMin, const glm::vec3 &outerMax, const glm::vec3 &innerMin,
+                         const glm::vec3 &innerMax)
+    {
+        return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z && innerMax.x <= outerMax.x
+               && innerMax.y <= outerMax.y && innerMax.z <= outerMax.z;
+    }
+
+    static float surfaceArea(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        glm::vec3 size = boundsMax - boundsMin;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    // slab test, entry is where the ray enters the box (0 when it starts inside)
+    static bool rayHits(const glm::vec3 &origin, const glm::vec3 &inverse, float maxDistance, const glm::vec3 &boundsMin,
+                        const glm::vec3 &boundsMax, float &entry)
+    {
+        glm::vec3 t1 = (boundsMin - origin) * inverse;
+        glm::vec3 t2 = (boundsMax - origin) * inverse;
+        glm::vec3 entering = glm::min(t1, t2);
+        glm::vec3 leaving = glm::max(t1, t2);
+        entry = std::max(std::max(entering.x, entering.y), std::max(entering.z, 0.0f));
+        float exit = std::min(std::min(leaving.x, leaving.y), std::min(leaving.z, maxDistance));
+        return entry <= exit;
+    }
+
+    static Containment classify(const Frustum &frustum, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        Containment containment = INSIDE;
+        for (const glm::vec4 &plane : frustum.planes)
+        {
+            glm::vec3 normal(plane);
+            // the corners furthest along and against the normal
+            glm::vec3 positive(normal.x >= 0.0f ? boundsMax.x : boundsMin.x, normal.y >= 0.0f ? boundsMax.y : boundsMin.y,
+                               normal.z >= 0.0f ? boundsMax.z : boundsMin.z);
+            glm::vec3 negative(normal.x >= 0.0f ? boundsMin.x : boundsMax.x, normal.y >= 0.0f ? boundsMin.y : boundsMax.y,
+                               normal.z >= 0.0f ? boundsMin.z : boundsMax.z);
+            if (glm::dot(normal, positive) + plane.w < 0.0f)
+                return OUTSIDE;
+            if (glm::dot(normal, negative) + plane.w < 0.0f)
+                containment = INTERSECTING;
+        }
+        return containment;
+    }
+
+    // recomputes the box and height of index from its children
+    void fit(int index)
+    {
+        Node &node = nodes[index];
+        const Node &child1 = nodes[node.child1];
+        const Node &child2 = nodes[node.child2];
+        node.boundsMin = glm::min(child1.boundsMin, child2.boundsMin);
+        node.boundsMax = glm::max(child1.boundsMax, child2.boundsMax);
+        node.height = 1 + std::max(child1.height, child2.height);
+    }
+
+    // refits from index up to the root, stopping once a box no longer changes
+    void refit(int index)
+    {
+        while (index != NONE)
+        {
+            Node &node = nodes[index];
+            glm::vec3 oldMin = node.boundsMin, oldMax = node.boundsMax;
+            fit(index);
+            if (node.boundsMin == oldMin && node.boundsMax == oldMax)
+                return;
+            index = node.parent;
+        }
+    }
+
+    // cost of placing the leaf box below index: the area index grows by, or the new parent's area at a leaf
+    float descendCost(int index, const glm::vec3 &leafMin, const glm::vec3 &leafMax) const
+    {
+        const Node &node = nodes[index];
+        float combined = surfaceArea(glm::min(node.boundsMin, leafMin), glm::max(node.boundsMax, leafMax));
+        return node.isLeaf() ? combined : combined - surfaceArea(node.boundsMin, node.boundsMax);
+    }
+
+    void insertLeaf(int leaf)
+    {
+        if (root == NONE)
+        {
+            root = leaf;
+            nodes[root].parent = NONE;
+            return;
+        }
+
+        // descend towards the sibling whose union with the leaf adds the least surface area
+        glm::vec3 leafMin = nodes[leaf].boundsMin, leafMax = nodes[leaf].boundsMax;
+        int index = root;
+        while (!nodes[index].isLeaf())
+        {
+            const Node &node = nodes[index];
+            float area = surfaceArea(node.boundsMin, node.boundsMax);
+            float combinedArea = surfaceArea(glm::min(node.boundsMin, leafMin), glm::max(node.boundsMax, leafMax));
+            // a new parent of this node and the leaf, against the growth every ancestor inherits going deeper
+            float cost = 2.0f * combinedArea;
+            float inheritance = 2.0f * (combinedArea - area);
+            float cost1 = descendCost(node.child1, leafMin, leafMax) + inheritance;
+            float cost2 = descendCost(node.child2, leafMin, leafMax) + inheritance;
+            if (cost < cost1 && cost < cost2)
+                break;
+            index = cost1 < cost2 ? node.child1 : node.child2;
+        }
+
+        int sibling = index;
+        int oldParent = nodes[sibling].parent;
+        int newParent = allocate();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].child1 = sibling;
+        nodes[newParent].child2 = leaf;
+        fit(newParent);
+        if (oldParent == NONE)
+            root = newParent;
+        else if (nodes[oldParent].child1 == sibling)
+            nodes[oldParent].child1 = newParent;
+        else
+            nodes[oldParent].child2 = newParent;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+
+        rebalance(newParent);
+    }
+
+    void removeLeaf(int leaf)
+    {
+        if (leaf == root)
+        {
+            root = NONE;
+            return;
+        }
+        int parent = nodes[leaf].parent;
+        int grandParent = nodes[parent].parent;
+        int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+        release(parent);
+        nodes[sibling].parent = grandParent;
+        if (grandParent == NONE)
+        {
+            root = sibling;
+            return;
+        }
+        if (nodes[grandParent].child1 == parent)
+            nodes[grandParent].child1 = sibling;
+        else
+            nodes[grandParent].child2 = sibling;
+        rebalance(grandParent);
+    }
+
+    // refits and balances from index up to the root
+    void rebalance(int index)
+    {
+        while (index != NONE)
+        {
+            index = balance(index);
+            fit(index);
+            index = nodes[index].parent;
+        }
+    }
+
+    // rotates the taller grandchild up when the children of a differ in height by more than one; returns the
+    // node now in a's place
+    int balance(int a)
+    {
+        Node &nodeA = nodes[a];
+        if (nodeA.isLeaf() || nodeA.height < 2)
+            return a;
+        int b = nodeA.child1, c = nodeA.child2;
+        int difference = nodes[c].height - nodes[b].height;
+        if (difference > 1)
+            return rotateUp(a, c, false);
+        if (difference < -1)
+            return rotateUp(a, b, true);
+        return a;
+    }
+
+    // moves child up into a's place; a becomes child's first child, keeping its other child and taking child's
+    // shorter subtree
+    int rotateUp(int a, int child, bool childIsFirst)
+    {
+        Node &nodeA = nodes[a];
+        Node &nodeChild = nodes[child];
+        int f = nodeChild.child1, g = nodeChild.child2;
+
+        nodeChild.child1 = a;
+        nodeChild.parent = nodeA.parent;
+        nodeA.parent = child;
+        if (nodeChild.parent == NONE)
+            root = child;
+        else if (nodes[nodeChild.parent].child1 == a)
+            nodes[nodeChild.parent].child1 = child;
+        else
+            nodes[nodeChild.parent].child2 = child;
+
+        // the taller grandchild stays with child, the shorter one moves under a in child's old slot
+        int taller = nodes[f].height > nodes[g].height ? f : g;
+        int shorter = taller == f ? g : f;
+        nodeChild.child2 = taller;
+        if (childIsFirst)
+            nodeA.child1 = shorter;
+        else
+            nodeA.child2 = shorter;
+        nodes[shorter].parent = a;
+        fit(a);
+        fit(child);
+        return child;
+    }
+};
+#endif
@@ -0,0 +1,152 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// The six planes of a view frustum, extracted from a clip matrix such as projection * view (Gribb and Hartmann):
+// a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0. The planes are normalized, so that value is
+// the distance to the plane and spheres test with one dot product each. Bounds in the space the matrix maps
+// from are tested, world space for projection * view.
+struct Frustum {
+    enum Plane { LEFT, RIGHT, BOTTOM, TOP, NEAR_PLANE, FAR_PLANE, PLANES };
+
+    glm::vec4 planes[PLANES];
+
+    static Frustum fromMatrix(const glm::mat4 &clip)
+    {
+        // rows of the column-major matrix
+        glm::vec4 x(clip[0][0], clip[1][0], clip[2][0], clip[3][0]);
+        glm::vec4 y(clip[0][1], clip[1][1], clip[2][1], clip[3][1]);
+        glm::vec4 z(clip[0][2], clip[1][2], clip[2][2], clip[3][2]);
+        glm::vec4 w(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+        Frustum frustum;
+        frustum.planes[LEFT] = w + x;
+        frustum.planes[RIGHT] = w - x;
+        frustum.planes[BOTTOM] = w + y;
+        frustum.planes[TOP] = w - y;
+        frustum.planes[NEAR_PLANE] = w + z;
+        frustum.planes[FAR_PLANE] = w - z;
+        for (glm::vec4 &plane : frustum.planes)
+            plane = plane * (1.0f / glm::length(glm::vec3(plane)));
+        return frustum;
+    }
+
+    // false only when the sphere lies entirely outside one plane; spheres near a corner may pass
+    bool sphereVisible(const glm::vec3 &center, float radius) const
+    {
+        for (const glm::vec4 &plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        }
+        return true;
+    }
+
+    // the same for an axis-aligned box: the corner furthest along each plane's normal decides
+    bool boxVisible(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const
+    {
+        for (const glm::vec4 &plane : planes)
+        {
+            glm::vec3 corner(plane.x >= 0.0f ? boundsMax.x : boundsMin.x, plane.y >= 0.0f ? boundsMax.y : boundsMin.y,
+                             plane.z >= 0.0f ? boundsMax.z : boundsMin.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    // tests count spheres stored as separate coordinate arrays, four at a time with SSE; writes 1 for visible and
+    // 0 for culled spheres to visible and returns how many are visible
+    size_t cullSpheres(const float *x, const float *y, const float *z, const float *radius, size_t count,
+                       uint8_t *visible) const
+    {
+        size_t i = 0, inside = 0;
+#ifdef FRUSTUM_SSE
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 cx = _mm_loadu_ps(x + i);
+            __m128 cy = _mm_loadu_ps(y + i);
+            __m128 cz = _mm_loadu_ps(z + i);
+            __m128 negativeRadius = _mm_xor_ps(_mm_loadu_ps(radius + i), signBit);
+            __m128 outside = _mm_setzero_ps();
+            for (const glm::vec4 &plane : planes)
+            {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+                                             _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+            }
+            int culled = _mm_movemask_ps(outside);
+            for (size_t lane = 0; lane < 4; lane++)
+            {
+                visible[i + lane] = (culled >> lane & 1) ? 0 : 1;
+                inside += visible[i + lane];
+            }
+        }
+#endif
+        for (; i < count; i++)
+        {
+            visible[i] = sphereVisible(glm::vec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+            inside += visible[i];
+        }
+        return inside;
+    }
+};
+
+// Gathers a frame's objects as world space bounding spheres with what to do for each visible one, then tests
+// all spheres against the frustum in one batch and runs the callbacks of those that pass.
+class FrustumCuller
+{
+public:
+    struct FrameStats {
+        unsigned int visible = 0;
+        unsigned int culled = 0;
+    };
+
+    void add(const glm::vec3 &center, float radius, std::function<void()> visible)
+    {
+        x.push_back(center.x);
+        y.push_back(center.y);
+        z.push_back(center.z);
+        radii.push_back(radius);
+        callbacks.push_back(std::move(visible));
+    }
+
+    // culls everything added since the last run, runs the visible objects' callbacks in the order they were
+    // added and starts over
+    FrameStats run(const Frustum &frustum)
+    {
+        FrameStats stats;
+        visibility.resize(callbacks.size());
+        stats.visible = (unsigned int)frustum.cullSpheres(x.data(), y.data(), z.data(), radii.data(), callbacks.size(),
+                                                          visibility.data());
+        stats.culled = (unsigned int)callbacks.size() - stats.visible;
+        for (size_t i = 0; i < callbacks.size(); i++)
+        {
+            if (visibility[i])
+                callbacks[i]();
+        }
+        x.clear();
+        y.clear();
+        z.clear();
+        radii.clear();
+        callbacks.clear();
+        return stats;
+    }
+
+private:
+    std::vector<float> x, y, z, radii;
+    std::vector<std::function<void()>> callbacks;
+    std::vector<uint8_t> visibility;
+};
+#endif
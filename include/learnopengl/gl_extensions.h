@@ -0,0 +1,91 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <set>
+#include <string>
+
+// The generated glad loader only covers core 3.3, so extension tokens used by the renderer are defined here.
+// EXT_texture_compression_s3tc: BC1 (DXT1) and BC3 (DXT5). BC5 is RGTC2, which is core since 3.0.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+// ARB_get_program_binary, core since 4.1
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+// KHR_parallel_shader_compile (same values as the ARB version)
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+// ARB_draw_indirect, core since 4.0
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// Extension queries against the current context. The list is read once with glGetStringi on first use,
+// so the first call must happen on the GL thread after the context has been made current.
+class GLExtensions
+{
+public:
+    static bool has(const std::string &name)
+    {
+        const std::set<std::string> &names = all();
+        return names.find(name) != names.end();
+    }
+
+    static bool hasS3TC()
+    {
+        return has("GL_EXT_texture_compression_s3tc");
+    }
+
+    // GL_COMPLETION_STATUS_KHR can be queried without waiting for the compiler
+    static bool hasParallelShaderCompile()
+    {
+        return has("GL_KHR_parallel_shader_compile") || has("GL_ARB_parallel_shader_compile");
+    }
+
+    // glMultiDrawElementsIndirect with a baseInstance the instanced attributes honour, core since 4.3
+    static bool hasMultiDrawIndirect()
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        return major * 10 + minor >= 43 || (has("GL_ARB_multi_draw_indirect") && has("GL_ARB_base_instance"));
+    }
+
+private:
+    static const std::set<std::string>& all()
+    {
+        static std::set<std::string> names = query();
+        return names;
+    }
+
+    static std::set<std::string> query()
+    {
+        std::set<std::string> names;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const GLubyte *name = glGetStringi(GL_EXTENSIONS, (GLuint)i);
+            if (name)
+                names.insert((const char*)name);
+        }
+        return names;
+    }
+};
+#endif
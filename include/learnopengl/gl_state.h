@@ -0,0 +1,412 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Shadow of the context's bindings and of the depth and blend state the renderer changes. Every call whose value
+// is already current is filtered instead of reaching the driver. The shadow is only right while everything that
+// binds, enables or deletes the tracked objects goes through here; after code that bypasses it call invalidate(),
+// which makes the next call of each kind go through.
+//
+// Set LEARNOPENGL_GL_STATE_VALIDATE=1 in the environment (or call setValidation) to compare the shadow with
+// glGet* on every filtered call and in validate(); each mismatch is reported as ERROR::GL_STATE::DESYNC and the
+// shadow adopts the context's value.
+class GLState
+{
+public:
+    static const int MAX_TEXTURE_UNITS = 16;
+
+    struct FrameStats {
+        unsigned int issued = 0;    // state calls passed on to GL
+        unsigned int filtered = 0;  // calls that set the current value
+    };
+
+    // the shadow of the one context the application renders with, used from the GL thread only
+    static GLState &instance()
+    {
+        static GLState state;
+        return state;
+    }
+
+    GLState(const GLState &) = delete;
+    GLState &operator=(const GLState &) = delete;
+
+    void setValidation(bool enabled)
+    {
+        validating = enabled;
+    }
+
+    // forgets everything, for after code that changed state behind the shadow's back
+    void invalidate()
+    {
+        program = vao = UNKNOWN;
+        activeUnit = -1;
+        // std::fill takes the value by reference, which would need a definition of the static member
+        GLuint unknown = UNKNOWN;
+        for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            std::fill(textures[unit], textures[unit] + TEXTURE_TARGETS, unknown);
+        std::fill(buffers, buffers + BUFFER_TARGETS, unknown);
+        depthTest = blend = depthMask = -1;
+        depthFunc = blendSource = blendDestination = UNKNOWN;
+    }
+
+    bool useProgram(GLuint id)
+    {
+        if (filter(program, id, GL_CURRENT_PROGRAM, "program"))
+            return false;
+        glUseProgram(program = id);
+        return true;
+    }
+
+    bool bindVertexArray(GLuint id)
+    {
+        if (filter(vao, id, GL_VERTEX_ARRAY_BINDING, "vertex array"))
+            return false;
+        glBindVertexArray(vao = id);
+        return true;
+    }
+
+    // unit is an index, 0 for GL_TEXTURE0
+    bool activeTexture(int unit)
+    {
+        if (activeUnit == unit)
+        {
+            if (validating)
+                checkActiveUnit();
+            stats.filtered++;
+            return false;
+        }
+        glActiveTexture(GL_TEXTURE0 + (activeUnit = unit));
+        stats.issued++;
+        return true;
+    }
+
+    // binds to the active unit, like glBindTexture
+    bool bindTexture(GLenum target, GLuint id)
+    {
+        if (activeUnit < 0)
+            activeTexture(0);
+        int index = textureTarget(target);
+        if (index < 0 || activeUnit >= MAX_TEXTURE_UNITS)
+        {
+            glBindTexture(target, id);
+            stats.issued++;
+            return true;
+        }
+        GLuint &bound = textures[activeUnit][index];
+        if (filter(bound, id, textureBinding(index), "texture"))
+            return false;
+        glBindTexture(target, bound = id);
+        return true;
+    }
+
+    // binds to unit, switching the active unit only when the binding changes
+    bool bindTexture(int unit, GLenum target, GLuint id)
+    {
+        int index = textureTarget(target);
+        if (index >= 0 && unit < MAX_TEXTURE_UNITS && textures[unit][index] == id)
+        {
+            if (validating)
+                checkTexture(unit, index, "texture");
+            stats.filtered++;
+            return false;
+        }
+        activeTexture(unit);
+        return bindTexture(target, id);
+    }
+
+    // the element array binding is part of the bound VAO, so it is always passed through
+    bool bindBuffer(GLenum target, GLuint id)
+    {
+        int index = bufferTarget(target);
+        if (index < 0)
+        {
+            glBindBuffer(target, id);
+            stats.issued++;
+            return true;
+        }
+        if (filter(buffers[index], id, bufferBinding(index), "buffer"))
+            return false;
+        glBindBuffer(target, buffers[index] = id);
+        return true;
+    }
+
+    // also binds the buffer to target's generic binding point, as GL does
+    void bindBufferBase(GLenum target, GLuint index, GLuint id)
+    {
+        glBindBufferBase(target, index, id);
+        stats.issued++;
+        int generic = bufferTarget(target);
+        if (generic >= 0)
+            buffers[generic] = id;
+    }
+
+    bool setDepthTest(bool enabled)
+    {
+        return setCapability(depthTest, enabled, GL_DEPTH_TEST, "depth test");
+    }
+
+    bool setBlend(bool enabled)
+    {
+        return setCapability(blend, enabled, GL_BLEND, "blend");
+    }
+
+    bool setDepthFunc(GLenum func)
+    {
+        if (filter(depthFunc, func, GL_DEPTH_FUNC, "depth func"))
+            return false;
+        glDepthFunc(depthFunc = func);
+        return true;
+    }
+
+    bool setDepthMask(bool enabled)
+    {
+        if (depthMask == (int)enabled)
+        {
+            if (validating)
+                checkBoolean(GL_DEPTH_WRITEMASK, depthMask, "depth mask");
+            stats.filtered++;
+            return false;
+        }
+        glDepthMask((depthMask = enabled) ? GL_TRUE : GL_FALSE);
+        stats.issued++;
+        return true;
+    }
+
+    bool setBlendFunc(GLenum source, GLenum destination)
+    {
+        if (blendSource == source && blendDestination == destination)
+        {
+            if (validating)
+            {
+                check(GL_BLEND_SRC_RGB, blendSource, "blend source");
+                check(GL_BLEND_DST_RGB, blendDestination, "blend destination");
+            }
+            stats.filtered++;
+            return false;
+        }
+        glBlendFunc(blendSource = source, blendDestination = destination);
+        stats.issued++;
+        return true;
+    }
+
+    // delete through these so a recycled name is not mistaken for the binding GL dropped on deletion
+    void deleteTexture(GLuint id)
+    {
+        glDeleteTextures(1, &id);
+        for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            std::replace(textures[unit], textures[unit] + TEXTURE_TARGETS, id, 0u);
+    }
+
+    void deleteBuffer(GLuint id)
+    {
+        glDeleteBuffers(1, &id);
+        std::replace(buffers, buffers + BUFFER_TARGETS, id, 0u);
+    }
+
+    void deleteVertexArray(GLuint id)
+    {
+        glDeleteVertexArrays(1, &id);
+        if (vao == id)
+            vao = 0;
+    }
+
+    // compares the whole known shadow with the context, returns the number of mismatches
+    unsigned int validate()
+    {
+        unsigned int mismatches = 0;
+        if (program != UNKNOWN)
+            mismatches += check(GL_CURRENT_PROGRAM, program, "program") ? 0 : 1;
+        if (vao != UNKNOWN)
+            mismatches += check(GL_VERTEX_ARRAY_BINDING, vao, "vertex array") ? 0 : 1;
+        for (int index = 0; index < BUFFER_TARGETS; index++)
+        {
+            if (buffers[index] != UNKNOWN)
+                mismatches += check(bufferBinding(index), buffers[index], "buffer") ? 0 : 1;
+        }
+        for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+        {
+            for (int index = 0; index < TEXTURE_TARGETS; index++)
+            {
+                if (textures[unit][index] != UNKNOWN)
+                    mismatches += checkTexture(unit, index, "texture") ? 0 : 1;
+            }
+        }
+        if (activeUnit >= 0)
+            mismatches += checkActiveUnit() ? 0 : 1;
+        if (depthTest >= 0)
+            mismatches += checkBoolean(GL_DEPTH_TEST, depthTest, "depth test") ? 0 : 1;
+        if (blend >= 0)
+            mismatches += checkBoolean(GL_BLEND, blend, "blend") ? 0 : 1;
+        if (depthMask >= 0)
+            mismatches += checkBoolean(GL_DEPTH_WRITEMASK, depthMask, "depth mask") ? 0 : 1;
+        if (depthFunc != UNKNOWN)
+            mismatches += check(GL_DEPTH_FUNC, depthFunc, "depth func") ? 0 : 1;
+        if (blendSource != UNKNOWN)
+            mismatches += check(GL_BLEND_SRC_RGB, blendSource, "blend source") ? 0 : 1;
+        if (blendDestination != UNKNOWN)
+            mismatches += check(GL_BLEND_DST_RGB, blendDestination, "blend destination") ? 0 : 1;
+        return mismatches;
+    }
+
+    bool validation() const
+    {
+        return validating;
+    }
+
+    // counters since the last endFrame(), which returns and clears them
+    FrameStats endFrame()
+    {
+        FrameStats finished = stats;
+        stats = FrameStats();
+        return finished;
+    }
+
+private:
+    static const GLuint UNKNOWN = ~0u;
+    static const int TEXTURE_TARGETS = 4;
+    static const int BUFFER_TARGETS = 5;
+
+    GLuint program, vao;
+    int activeUnit;
+    GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+    GLuint buffers[BUFFER_TARGETS];
+    int depthTest, blend, depthMask;  // -1 while unknown
+    GLenum depthFunc, blendSource, blendDestination;
+    bool validating = false;
+    FrameStats stats;
+
+    GLState()
+    {
+        invalidate();
+        const char *setting = getenv("LEARNOPENGL_GL_STATE_VALIDATE");
+        validating = setting && strcmp(setting, "0") != 0;
+    }
+
+    // tracked targets by index, with the glGet name of their binding
+    static int textureTarget(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_CUBE_MAP: return 1;
+        case GL_TEXTURE_2D_ARRAY: return 2;
+        case GL_TEXTURE_BUFFER: return 3;
+        default: return -1;
+        }
+    }
+
+    static GLenum textureBinding(int index)
+    {
+        static const GLenum bindings[TEXTURE_TARGETS] = {
+            GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_CUBE_MAP, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_BUFFER
+        };
+        return bindings[index];
+    }
+
+    static int bufferTarget(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_UNIFORM_BUFFER: return 1;
+        case GL_PIXEL_UNPACK_BUFFER: return 2;
+        case GL_TEXTURE_BUFFER: return 3;
+        case GL_COPY_WRITE_BUFFER: return 4;
+        default: return -1;
+        }
+    }
+
+    // the texture buffer and copy targets are queried by their own names
+    static GLenum bufferBinding(int index)
+    {
+        static const GLenum bindings[BUFFER_TARGETS] = {
+            GL_ARRAY_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING, GL_PIXEL_UNPACK_BUFFER_BINDING, GL_TEXTURE_BUFFER,
+            GL_COPY_WRITE_BUFFER
+        };
+        return bindings[index];
+    }
+
+    // true when the call can be skipped, counting it either way
+    bool filter(GLuint &shadow, GLuint value, GLenum binding, const char *what)
+    {
+        if (shadow != value)
+        {
+            stats.issued++;
+            return false;
+        }
+        if (validating && !check(binding, shadow, what))
+        {
+            // the context disagreed, check() adopted its value; issue the call after all
+            stats.issued++;
+            return false;
+        }
+        stats.filtered++;
+        return true;
+    }
+
+    bool setCapability(int &shadow, bool enabled, GLenum capability, const char *what)
+    {
+        if (shadow == (int)enabled)
+        {
+            if (validating)
+                checkBoolean(capability, shadow, what);
+            stats.filtered++;
+            return false;
+        }
+        if ((shadow = enabled))
+            glEnable(capability);
+        else
+            glDisable(capability);
+        stats.issued++;
+        return true;
+    }
+
+    // compares one shadowed value with the context's, adopting the context's on a mismatch
+    bool check(GLenum pname, GLuint &shadow, const char *what)
+    {
+        GLint actual = 0;
+        glGetIntegerv(pname, &actual);
+        if ((GLuint)actual == shadow)
+            return true;
+        std::cout << "ERROR::GL_STATE::DESYNC " << what << ": shadow " << shadow << ", context " << actual << std::endl;
+        shadow = (GLuint)actual;
+        return false;
+    }
+
+    bool checkActiveUnit()
+    {
+        GLuint unit = GL_TEXTURE0 + (GLuint)activeUnit;
+        bool matches = check(GL_ACTIVE_TEXTURE, unit, "active texture");
+        activeUnit = (int)(unit - GL_TEXTURE0);
+        return matches;
+    }
+
+    bool checkBoolean(GLenum pname, int &shadow, const char *what)
+    {
+        GLboolean actual = GL_FALSE;
+        glGetBooleanv(pname, &actual);
+        if ((int)(actual == GL_TRUE) == shadow)
+            return true;
+        std::cout << "ERROR::GL_STATE::DESYNC " << what << ": shadow " << shadow << ", context " << (int)actual << std::endl;
+        shadow = actual == GL_TRUE;
+        return false;
+    }
+
+    // the binding of one unit, queried by making it active for the moment
+    bool checkTexture(int unit, int index, const char *what)
+    {
+        GLint previous = 0;
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &previous);
+        glActiveTexture(GL_TEXTURE0 + unit);
+        bool matches = check(textureBinding(index), textures[unit][index], what);
+        glActiveTexture((GLenum)previous);
+        return matches;
+    }
+};
+#endif
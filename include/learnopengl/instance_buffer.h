@@ -0,0 +1,90 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+
+#include <cstddef>
+
+// Per-instance model matrices for instanced draws. A shader reads them as
+//   layout (location = 5) in mat4 aInstanceModel;
+// which takes the four attribute locations 5-8, one column each, advanced once per instance.
+class InstanceBuffer
+{
+public:
+    static const GLuint MATRIX_LOCATION = 5;
+
+    InstanceBuffer() = default;
+
+    ~InstanceBuffer()
+    {
+        if (vbo)
+            GLState::instance().deleteBuffer(vbo);
+    }
+
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+    InstanceBuffer(InstanceBuffer &&other) : vbo(other.vbo), capacity(other.capacity)
+    {
+        other.vbo = 0;
+        other.capacity = 0;
+    }
+
+    InstanceBuffer &operator=(InstanceBuffer &&other)
+    {
+        if (this != &other)
+        {
+            if (vbo)
+                GLState::instance().deleteBuffer(vbo);
+            vbo = other.vbo;
+            capacity = other.capacity;
+            other.vbo = 0;
+            other.capacity = 0;
+        }
+        return *this;
+    }
+
+    // replaces the contents with count matrices. Storage grows to the next power of two and is orphaned on
+    // every update, so an instanced draw still reading the previous contents does not stall the upload.
+    void update(const glm::mat4 *transforms, size_t count)
+    {
+        GLState &state = GLState::instance();
+        if (!vbo)
+            glGenBuffers(1, &vbo);
+        state.bindBuffer(GL_ARRAY_BUFFER, vbo);
+        while (capacity < count)
+            capacity = capacity ? capacity * 2 : 16;
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), transforms);
+    }
+
+    // adds the matrix attributes to vao, reading from this buffer; the buffer may grow afterwards
+    void attach(GLuint vao)
+    {
+        GLState &state = GLState::instance();
+        if (!vbo)
+            glGenBuffers(1, &vbo);
+        state.bindVertexArray(vao);
+        state.bindBuffer(GL_ARRAY_BUFFER, vbo);
+        for (GLuint column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(MATRIX_LOCATION + column);
+            glVertexAttribPointer(MATRIX_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                  (void*)(column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(MATRIX_LOCATION + column, 1);
+        }
+    }
+
+    GLuint id() const
+    {
+        return vbo;
+    }
+
+private:
+    GLuint vbo = 0;
+    size_t capacity = 0;
+};
+#endif
@@ -0,0 +1,36 @@
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <fstream>
+#include <string>
+
+// Resident memory of this process as reported by /proc/self/status (Linux), in KiB; 0 where unavailable.
+class MemoryUsage
+{
+public:
+    // VmHWM: the peak resident set size so far
+    static size_t peakResidentKiB()
+    {
+        return statusField("VmHWM:");
+    }
+
+    // VmRSS: the resident set size right now
+    static size_t residentKiB()
+    {
+        return statusField("VmRSS:");
+    }
+
+private:
+    static size_t statusField(const std::string &name)
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, name.size(), name) == 0)
+                return std::stoul(line.substr(name.size()));
+        }
+        return 0;
+    }
+};
+#endif
@@ -6,9 +6,14 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/gl_state.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_packing.h>
 
+#include <algorithm>
+#include <cmath>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -33,37 +38,194 @@ struct Texture {
     string path;
 };
 
+// material texture as referenced by the source asset, path is relative to the model directory
+struct TextureRef {
+    string type;
+    string path;
+};
+
+// axis-aligned box around the vertex positions, zero for no vertices
+inline void vertexBounds(const vector<Vertex> &vertices, glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+{
+    boundsMin = boundsMax = vertices.empty() ? glm::vec3(0.0f) : vertices[0].Position;
+    for (const Vertex &vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.Position);
+        boundsMax = glm::max(boundsMax, vertex.Position);
+    }
+}
+
+// CPU-side result of importing one mesh, before any GL objects are created for it
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<TextureRef>   textures;
+    // object space bounds, computed on import and kept in the mesh cache; empty (min above max) until then
+    glm::vec3 boundsMin = glm::vec3(INFINITY);
+    glm::vec3 boundsMax = glm::vec3(-INFINITY);
+    // the material's diffuse color, drawn through a 1x1 texture when there is no diffuse map
+    glm::vec3 diffuseColor = glm::vec3(1.0f);
+
+    bool hasBounds() const
+    {
+        return boundsMin.x <= boundsMax.x;
+    }
+
+    void computeBounds()
+    {
+        vertexBounds(vertices, boundsMin, boundsMax);
+    }
+};
+
+// per-model choices for how its meshes are imported and uploaded
+struct MeshOptions {
+    bool optimize = true;       // weld and reorder for the vertex cache, overdraw and fetch on import (MeshOptimizer)
+    bool keepCPUData = true;    // false frees each mesh's vertices and indices once they are uploaded
+    bool packVertices = false;  // upload the 20-byte PackedVertex layout instead of Vertex
+};
+
 class Mesh {
 public:
-    // mesh Data
+    // part of the index buffer drawn with one call; 16-bit ranges are relative to baseVertex
+    struct IndexRange {
+        unsigned int first;   // first index of the range
+        unsigned int count;
+        int baseVertex;
+    };
+
+    // meshes above 65536 vertices are split into at most this many 16-bit ranges, beyond that the extra draw
+    // calls cost more than the smaller index buffer saves and 32-bit indices are kept
+    static const unsigned int MAX_INDEX_RANGES = 8;
+
+    // mesh Data, vertices and indices are empty after releaseCPUData()
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
 
     unsigned int VAO;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    GLenum indexType;             // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    vector<IndexRange> indexRanges;
     std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // packed meshes store positions relative to their bounds: position = positionOffset + stored * positionScale
+    bool packed;
+    glm::vec3 positionOffset;
+    glm::vec3 positionScale;
+    // object space bounds of the vertices
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    // InstanceBuffer whose matrices the VAO reads, 0 until the mesh is first drawn instanced
+    GLuint instanceBuffer = 0;
+    // slot of the copy of the geometry in a MeshArena, -1 when the mesh is only drawn from its own buffers
+    int arenaSlot = -1;
+    // constructor, the vectors are moved into the mesh: pass them with std::move to avoid copying the geometry
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool packVertices = false)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), packed(packVertices)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
-
+        vertexBounds(this->vertices, boundsMin, boundsMax);
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
 
-    // render the mesh
+    // the same with bounds known from the import, see MeshData
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, const glm::vec3 &boundsMin,
+         const glm::vec3 &boundsMax, bool packVertices = false)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), packed(packVertices),
+          boundsMin(boundsMin), boundsMax(boundsMax)
+    {
+        setupMesh();
+    }
+
+    // bytes of the uploaded index buffer
+    size_t indexBytes() const
+    {
+        return indexBufferSize;
+    }
+
+    // bytes of the uploaded vertex buffer, Vertex or PackedVertex per vertex
+    size_t vertexBytes() const
+    {
+        return (size_t)vertexCount * (packed ? sizeof(PackedVertex) : sizeof(Vertex));
+    }
+
+    // the GL buffers, for copying the geometry elsewhere (MeshArena)
+    GLuint vertexBuffer() const
+    {
+        return VBO;
+    }
+    GLuint elementBuffer() const
+    {
+        return EBO;
+    }
+
+    // whether the material has a texture of type, e.g. "texture_specular"
+    bool hasTexture(const string &type) const
+    {
+        for (const Texture &texture : textures)
+        {
+            if (texture.type == type)
+                return true;
+        }
+        return false;
+    }
+
+    // frees the CPU copy of the geometry once it lives in the GL buffers, drawing only needs the index ranges
+    void releaseCPUData()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+    }
+
+    // frees the mesh's own GL buffers and VAO once a MeshArena holds a copy of the geometry; from then on the
+    // mesh must only be drawn through the arena, not with Draw, DrawInstanced or its VAO
+    void releaseGPUBuffers()
+    {
+        GLState &state = GLState::instance();
+        state.deleteVertexArray(VAO);
+        state.deleteBuffer(VBO);
+        state.deleteBuffer(EBO);
+        VAO = VBO = EBO = 0;
+    }
+
+    // render the mesh; textures and VAO already bound (by the previous mesh of the material) are not rebound
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
+        GLState &state = GLState::instance();
+        for(unsigned int i = 0; i < textures.size(); i++)
+            state.bindTexture((int)i, GL_TEXTURE_2D, textures[i].id);
+        SetUniforms(shader);
+
+        // draw mesh
+        state.bindVertexArray(VAO);
+        DrawElements();
+    }
+
+    // draws count instances in one call per index range, the model matrices come from the attached instance buffer
+    void DrawInstanced(Shader &shader, GLsizei count)
+    {
+        GLState &state = GLState::instance();
+        for(unsigned int i = 0; i < textures.size(); i++)
+            state.bindTexture((int)i, GL_TEXTURE_2D, textures[i].id);
+        SetUniforms(shader);
+
+        state.bindVertexArray(VAO);
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        for (const IndexRange &range : indexRanges)
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.count, indexType, (void*)(range.first * indexSize), count,
+                                              range.baseVertex);
+    }
+
+    // points the material samplers at units 0..N-1 in the order of textures and sets how the lighting shader
+    // decodes the vertices; for callers binding the textures and VAO themselves, like RenderQueue
+    void SetUniforms(Shader &shader) const
+    {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -77,63 +239,176 @@ public:
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
 
             // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            shader.setInt(glslIdentifierPrefix + name + number, i);
         }
 
+        // how the lighting shader decodes the vertices, identity for plain Vertex data
+        shader.setBool("packedVertex", packed);
+        shader.setVec3("positionOffset", positionOffset);
+        shader.setVec3("positionScale", positionScale);
+    }
 
+    // issues the draw calls, with the VAO bound
+    void DrawElements() const
+    {
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        for (const IndexRange &range : indexRanges)
+            glDrawElementsBaseVertex(GL_TRIANGLES, range.count, indexType, (void*)(range.first * indexSize), range.baseVertex);
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // points the attributes of the bound VAO at the bound GL_ARRAY_BUFFER, holding Vertex or PackedVertex data.
+    // Packed vertices use the same locations and are decoded by the shader when packedVertex is set; the
+    // bitangent sign rides in the position's w, so location 4 stays disabled.
+    static void SetVertexAttributes(bool packed)
+    {
+        if (packed)
+        {
+            // vertex Positions, normalized to [0, 1] within the bounds
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+            // vertex normals, octahedral
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+            // vertex texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+            // vertex tangent, octahedral
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, tangent));
+        }
+        else
+        {
+            // set the vertex attribute pointers
+            // vertex Positions
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+            // vertex normals
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+            // vertex texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+            // vertex tangent
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+            // vertex bitangent
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        }
     }
 
 private:
     // render data
     unsigned int VBO, EBO;
+    size_t indexBufferSize;
 
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
+        vertexCount = (unsigned int)vertices.size();
+        indexCount = (unsigned int)indices.size();
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        GLState &state = GLState::instance();
+        state.bindVertexArray(VAO);
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        setupIndices();
+
+        state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (packed)
+        {
+            setupPackedVertices();
+        }
+        else
+        {
+            positionOffset = glm::vec3(0.0f);
+            positionScale = glm::vec3(1.0f);
+            // load data into vertex buffers
+            // A great thing about structs is that their memory layout is sequential for all its items.
+            // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+            // again translates to 3/2 floats which translates to a byte array.
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        }
+        SetVertexAttributes(packed);
+
+        // later element array binds outside a VAO must not land in this one
+        state.bindVertexArray(0);
+    }
+
+
+    // uploads the indices as 16-bit whenever every range of them spans at most 65536 vertices. Ranges are cut
+    // greedily at triangle boundaries; after the import-time fetch optimization vertices appear in first-use
+    // order, so a large mesh splits into a handful of ranges.
+    void setupIndices()
+    {
+        indexRanges.clear();
+        if (indices.size() % 3 == 0)
+        {
+            IndexRange range = { 0, 0, 0 };
+            unsigned int low = ~0u, high = 0;
+            for (unsigned int t = 0; t < indices.size() && indexRanges.size() < MAX_INDEX_RANGES; t += 3)
+            {
+                unsigned int triangleLow = std::min(indices[t], std::min(indices[t + 1], indices[t + 2]));
+                unsigned int triangleHigh = std::max(indices[t], std::max(indices[t + 1], indices[t + 2]));
+                // a triangle spanning more than 65536 vertices on its own fits no 16-bit range, the ranges then
+                // cover fewer indices than there are and the mesh keeps 32-bit indices
+                if (triangleHigh - triangleLow > 0xffff)
+                    break;
+                if (range.count > 0 && std::max(high, triangleHigh) - std::min(low, triangleLow) > 0xffff)
+                {
+                    range.baseVertex = (int)low;
+                    indexRanges.push_back(range);
+                    range = { t, 0, 0 };
+                    low = ~0u;
+                    high = 0;
+                }
+                low = std::min(low, triangleLow);
+                high = std::max(high, triangleHigh);
+                range.count += 3;
+            }
+            if (range.count > 0 && indexRanges.size() < MAX_INDEX_RANGES)
+            {
+                range.baseVertex = (int)low;
+                indexRanges.push_back(range);
+            }
+        }
+
+        unsigned int covered = 0;
+        for (const IndexRange &range : indexRanges)
+            covered += range.count;
+        if (covered == indices.size() && !indices.empty())
+        {
+            vector<unsigned short> shortIndices(indices.size());
+            for (const IndexRange &range : indexRanges)
+                for (unsigned int i = range.first; i < range.first + range.count; i++)
+                    shortIndices[i] = (unsigned short)(indices[i] - (unsigned int)range.baseVertex);
+            indexType = GL_UNSIGNED_SHORT;
+            indexBufferSize = shortIndices.size() * sizeof(unsigned short);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferSize, shortIndices.data(), GL_STATIC_DRAW);
+            return;
+        }
+
+        indexRanges.assign(1, IndexRange{ 0, (unsigned int)indices.size(), 0 });
+        indexType = GL_UNSIGNED_INT;
+        indexBufferSize = indices.size() * sizeof(unsigned int);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferSize, indices.data(), GL_STATIC_DRAW);
+    }
+
+    // quantizes the vertices against the mesh bounds and uploads them as PackedVertex
+    void setupPackedVertices()
+    {
+        positionOffset = boundsMin;
+        positionScale = boundsMax - boundsMin;
+
+        vector<PackedVertex> packedVertices;
+        packedVertices.reserve(vertices.size());
+        for (const Vertex &vertex : vertices)
+            packedVertices.push_back(VertexPacking::pack(vertex.Position, vertex.Normal, vertex.TexCoords, vertex.Tangent,
+                                                         vertex.Bitangent, positionOffset, positionScale));
+        glBufferData(GL_ARRAY_BUFFER, packedVertices.size() * sizeof(PackedVertex), packedVertices.data(), GL_STATIC_DRAW);
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,456 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <vector>
+
+// Static meshes copied into one shared vertex buffer, index buffer and VAO, and drawn in batches: a frame's draws
+// sharing a program, textures, index type and per-batch uniforms go out as one glMultiDrawElementsIndirect
+// (GL 4.3 or ARB_multi_draw_indirect). The per-draw data is read from a buffer texture, six RGBA32F texels each:
+//
+//   drawData[6 * i + 0..3]  model matrix columns
+//   drawData[6 * i + 4]     positionOffset
+//   drawData[6 * i + 5]     positionScale
+//
+// where i is aDrawIndex (location 9), an instanced attribute over 0, 1, 2, ... that every indirect command
+// offsets by its baseInstance. Without multi-draw indirect, as on the 3.3 baseline, each command is issued on
+// its own with glDrawElementsBaseVertex and aDrawIndex as a constant attribute, still from the one VAO.
+// The lighting shader reads all of this in its multiDraw variant, see LightingFeatures.
+class MeshArena
+{
+public:
+    static const GLuint DRAW_INDEX_LOCATION = 9;
+    static const int DRAW_DATA_UNIT = 15;  // texture unit of the drawData buffer texture
+    static const int DRAW_DATA_TEXELS = 6;
+
+    struct FrameStats {
+        unsigned int draws = 0;    // meshes submitted
+        unsigned int batches = 0;
+        unsigned int calls = 0;    // GL draw calls issued for them
+    };
+
+    // draws of one program, set of textures and index type whose remaining uniforms are set once, by the
+    // setUniforms of the batch's first draw
+    struct Batch {
+        Shader *shader;
+        GLenum indexType;
+        int textureCount;
+        GLuint textures[RenderQueue::MAX_TEXTURES];
+        std::function<void(Shader&)> setUniforms;
+        float depth;  // of the nearest draw
+        unsigned int firstCommand;
+        unsigned int commandCount;
+    };
+
+    MeshArena() = default;
+
+    ~MeshArena()
+    {
+        GLState &state = GLState::instance();
+        if (vao)
+            state.deleteVertexArray(vao);
+        for (GLuint buffer : { vbo, ebo, drawIndexBuffer, drawDataBuffer, indirectBuffer })
+        {
+            if (buffer)
+                state.deleteBuffer(buffer);
+        }
+        if (drawDataTexture)
+            state.deleteTexture(drawDataTexture);
+    }
+
+    MeshArena(const MeshArena &) = delete;
+    MeshArena &operator=(const MeshArena &) = delete;
+
+    // copies the geometry of meshes into the arena and sets their arenaSlot, once, with the context current.
+    // Meshes in another vertex layout than the first keep drawing from their own buffers. The copies are made
+    // from the meshes' GL buffers, so meshes that released their CPU data can be merged as well. Unless
+    // keepMeshBuffers is set, merged meshes free their own buffers afterwards and are only drawn from the arena;
+    // keeping them doubles the GPU memory of the geometry and is only for comparing against per-mesh draws.
+    void build(const std::vector<Mesh*> &meshes, bool keepMeshBuffers = false)
+    {
+        if (vao)
+        {
+            std::cout << "ERROR::MESH_ARENA::BUILD the arena is already built" << std::endl;
+            return;
+        }
+        std::vector<Mesh*> merged;
+        size_t vertexBytes = 0, indexBytes = 0;
+        for (Mesh *mesh : meshes)
+        {
+            if (merged.empty())
+                packed = mesh->packed;
+            if (mesh->packed != packed)
+            {
+                std::cout << "WARNING::MESH_ARENA::LAYOUT a mesh with " << (mesh->packed ? "packed" : "plain")
+                          << " vertices is left out of the arena" << std::endl;
+                continue;
+            }
+            merged.push_back(mesh);
+            vertexBytes += mesh->vertexBytes();
+            indexBytes = align(indexBytes) + mesh->indexBytes();
+        }
+        if (merged.empty())
+            return;
+
+        GLState &state = GLState::instance();
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        state.bindVertexArray(vao);
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, NULL, GL_STATIC_DRAW);
+        state.bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, NULL, GL_STATIC_DRAW);
+        Mesh::SetVertexAttributes(packed);
+
+        // 16- and 32-bit index data share the buffer, each mesh's starting 4-byte aligned so firstIndex counts
+        // whole indices of either type
+        size_t stride = packed ? sizeof(PackedVertex) : sizeof(Vertex);
+        size_t vertexOffset = 0, indexOffset = 0;
+        for (Mesh *mesh : merged)
+        {
+            indexOffset = align(indexOffset);
+            glBindBuffer(GL_COPY_READ_BUFFER, mesh->vertexBuffer());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, vertexOffset, mesh->vertexBytes());
+            glBindBuffer(GL_COPY_READ_BUFFER, mesh->elementBuffer());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ELEMENT_ARRAY_BUFFER, 0, indexOffset, mesh->indexBytes());
+
+            Slot slot;
+            slot.indexType = mesh->indexType;
+            slot.positionOffset = mesh->positionOffset;
+            slot.positionScale = mesh->positionScale;
+            size_t indexSize = mesh->indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+            for (const Mesh::IndexRange &range : mesh->indexRanges)
+            {
+                DrawCommand command = { range.count, 1, (GLuint)(indexOffset / indexSize) + range.first,
+                                        (GLint)(vertexOffset / stride) + range.baseVertex, 0 };
+                slot.commands.push_back(command);
+            }
+            mesh->arenaSlot = (int)slots.size();
+            slots.push_back(slot);
+            vertexOffset += mesh->vertexBytes();
+            indexOffset += mesh->indexBytes();
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        // the copies are queued ahead of the deletes, GL keeps the sources alive until they are done
+        if (!keepMeshBuffers)
+        {
+            for (Mesh *mesh : merged)
+                mesh->releaseGPUBuffers();
+        }
+
+        // aDrawIndex, 0, 1, 2, ... per instance; filled as the frames need more draws
+        glGenBuffers(1, &drawIndexBuffer);
+        state.bindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+        glVertexAttribIPointer(DRAW_INDEX_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(DRAW_INDEX_LOCATION, 1);
+        reserveDrawIndices(1);
+        setMultiDraw(true);
+
+        glGenBuffers(1, &drawDataBuffer);
+        glGenTextures(1, &drawDataTexture);
+        state.bindBuffer(GL_TEXTURE_BUFFER, drawDataBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, DRAW_DATA_TEXELS * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+        state.bindTexture(DRAW_DATA_UNIT, GL_TEXTURE_BUFFER, drawDataTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, drawDataBuffer);
+
+        // later element array binds outside a VAO must not land in this one
+        state.bindVertexArray(0);
+        std::cout << "Mesh arena: " << slots.size() << " meshes, " << vertexBytes / 1024 << " KiB vertices, "
+                  << indexBytes / 1024 << " KiB indices" << (keepMeshBuffers ? ", also still in the meshes' own buffers" : "")
+                  << ", drawn with " << (multiDraw ? "glMultiDrawElementsIndirect" : "one glDrawElementsBaseVertex per draw") << std::endl;
+    }
+
+    // uses multi-draw indirect when enabled and the context supports it; LEARNOPENGL_MULTI_DRAW=0 turns it off.
+    // Returns whether it is used.
+    bool setMultiDraw(bool enabled)
+    {
+        multiDraw = enabled && functions().multiDrawElementsIndirect != nullptr;
+        if (!vao)
+            return multiDraw;
+        GLState::instance().bindVertexArray(vao);
+        if (multiDraw)
+            glEnableVertexAttribArray(DRAW_INDEX_LOCATION);
+        else
+            glDisableVertexAttribArray(DRAW_INDEX_LOCATION);
+        if (multiDraw && !indirectBuffer)
+            glGenBuffers(1, &indirectBuffer);
+        return multiDraw;
+    }
+
+    GLuint vertexArray() const
+    {
+        return vao;
+    }
+
+    // draws the geometry of the mesh in slot once, with vertexArray() bound, for passes that set their own
+    // transform and leave aDrawIndex unread, like the OcclusionCuller's occluder depth
+    void drawSlot(int slot) const
+    {
+        const Slot &geometry = slots[slot];
+        size_t indexSize = geometry.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        for (const DrawCommand &command : geometry.commands)
+            glDrawElementsBaseVertex(GL_TRIANGLES, command.count, geometry.indexType, (void*)(command.firstIndex * indexSize),
+                                     command.baseVertex);
+    }
+
+    // starts a frame
+    void begin()
+    {
+        items.clear();
+        batches.clear();
+        batchIndex.clear();
+    }
+
+    // the frame's batch for draws of mesh with shader whose other uniforms key identifies. A new batch comes
+    // without setUniforms, the caller fills it in. The reference is valid until the next call.
+    Batch &batch(Shader &shader, const Mesh &mesh, uint64_t key)
+    {
+        Key lookup;
+        lookup.shader = &shader;
+        lookup.indexType = mesh.indexType;
+        lookup.uniforms = key;
+        lookup.textureCount = (int)std::min(mesh.textures.size(), (size_t)RenderQueue::MAX_TEXTURES);
+        for (int i = 0; i < lookup.textureCount; i++)
+            lookup.textures[i] = mesh.textures[i].id;
+        auto it = batchIndex.find(lookup);
+        if (it != batchIndex.end())
+            return batches[it->second];
+        batchIndex.emplace(lookup, (unsigned int)batches.size());
+        Batch created;
+        created.shader = &shader;
+        created.indexType = mesh.indexType;
+        created.textureCount = lookup.textureCount;
+        std::copy(lookup.textures, lookup.textures + lookup.textureCount, created.textures);
+        created.depth = INFINITY;
+        created.firstCommand = created.commandCount = 0;
+        batches.push_back(std::move(created));
+        return batches.back();
+    }
+
+    // adds a draw of mesh, which must be in the arena, to batch
+    void add(Batch &batch, const Mesh &mesh, const glm::mat4 &model, float depth)
+    {
+        batch.depth = std::min(batch.depth, depth);
+        items.push_back({ (unsigned int)(&batch - batches.data()), (unsigned int)mesh.arenaSlot, model });
+    }
+
+    // uploads the frame's draw data and commands and queues one draw per batch; the batches run as part of
+    // queue.execute()
+    FrameStats flush(RenderQueue &queue, RenderQueue::Pass pass = RenderQueue::OPAQUE_PASS)
+    {
+        FrameStats stats;
+        stats.draws = (unsigned int)items.size();
+        stats.batches = (unsigned int)batches.size();
+        if (items.empty())
+            return stats;
+
+        // the draws grouped by batch, in submission order within one
+        std::vector<unsigned int> &starts = scratchStarts;
+        starts.assign(batches.size() + 1, 0);
+        for (const Item &item : items)
+            starts[item.batch + 1]++;
+        for (size_t b = 0; b < batches.size(); b++)
+            starts[b + 1] += starts[b];
+        std::vector<unsigned int> &order = scratchOrder;
+        order.resize(items.size());
+        for (unsigned int i = 0; i < items.size(); i++)
+            order[starts[items[i].batch]++] = i;
+
+        drawData.resize(items.size() * DRAW_DATA_TEXELS);
+        commands.clear();
+        unsigned int drawIndex = 0;
+        for (size_t b = 0; b < batches.size(); b++)
+        {
+            Batch &batch = batches[b];
+            batch.firstCommand = (unsigned int)commands.size();
+            // the placement above advanced every start to the end of its batch
+            for (; drawIndex < starts[b]; drawIndex++)
+            {
+                const Item &item = items[order[drawIndex]];
+                const Slot &slot = slots[item.slot];
+                glm::vec4 *texels = &drawData[drawIndex * DRAW_DATA_TEXELS];
+                for (int column = 0; column < 4; column++)
+                    texels[column] = item.model[column];
+                texels[4] = glm::vec4(slot.positionOffset, 0.0f);
+                texels[5] = glm::vec4(slot.positionScale, 0.0f);
+                for (DrawCommand command : slot.commands)
+                {
+                    command.baseInstance = drawIndex;
+                    commands.push_back(command);
+                }
+            }
+            batch.commandCount = (unsigned int)commands.size() - batch.firstCommand;
+            stats.calls += multiDraw ? 1 : batch.commandCount;
+        }
+
+        GLState &state = GLState::instance();
+        state.bindBuffer(GL_TEXTURE_BUFFER, drawDataBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, drawData.size() * sizeof(glm::vec4), drawData.data(), GL_STREAM_DRAW);
+        if (multiDraw)
+        {
+            reserveDrawIndices(items.size());
+            // the indirect binding is context state, not VAO state, and nothing else uses it
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_STREAM_DRAW);
+        }
+
+        for (unsigned int b = 0; b < batches.size(); b++)
+        {
+            const Batch &batch = batches[b];
+            RenderQueue::Draw draw;
+            draw.pass = pass;
+            draw.shader = batch.shader;
+            draw.vao = vao;
+            draw.depth = batch.depth;
+            for (int i = 0; i < batch.textureCount; i++)
+                draw.addTexture(GL_TEXTURE_2D, batch.textures[i]);
+            draw.issue = [this, b](Shader &shader) { drawBatch(shader, batches[b]); };
+            queue.submit(std::move(draw));
+        }
+        return stats;
+    }
+
+private:
+    // DrawElementsIndirectCommand
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // one mesh's geometry in the arena
+    struct Slot {
+        GLenum indexType;
+        glm::vec3 positionOffset;
+        glm::vec3 positionScale;
+        std::vector<DrawCommand> commands;  // one per index range, baseInstance set per draw
+    };
+
+    struct Item {
+        unsigned int batch;
+        unsigned int slot;
+        glm::mat4 model;
+    };
+
+    struct Key {
+        Shader *shader;
+        GLenum indexType;
+        uint64_t uniforms;
+        int textureCount;
+        GLuint textures[RenderQueue::MAX_TEXTURES];
+
+        bool operator<(const Key &other) const
+        {
+            if (shader != other.shader)
+                return shader < other.shader;
+            if (indexType != other.indexType)
+                return indexType < other.indexType;
+            if (uniforms != other.uniforms)
+                return uniforms < other.uniforms;
+            return std::lexicographical_compare(textures, textures + textureCount, other.textures,
+                                                other.textures + other.textureCount);
+        }
+    };
+
+    typedef void (APIENTRY *MultiDrawElementsIndirectFunction)(GLenum, GLenum, const void*, GLsizei, GLsizei);
+
+    struct Functions {
+        MultiDrawElementsIndirectFunction multiDrawElementsIndirect = nullptr;
+    };
+
+    GLuint vao = 0, vbo = 0, ebo = 0;
+    GLuint drawIndexBuffer = 0, drawDataBuffer = 0, drawDataTexture = 0, indirectBuffer = 0;
+    size_t drawIndexCapacity = 0;
+    bool packed = false;
+    bool multiDraw = false;
+    std::vector<Slot> slots;
+
+    // the current frame
+    std::vector<Item> items;
+    std::vector<Batch> batches;
+    std::map<Key, unsigned int> batchIndex;
+    std::vector<glm::vec4> drawData;
+    std::vector<DrawCommand> commands;
+    std::vector<unsigned int> scratchStarts, scratchOrder;
+
+    void drawBatch(Shader &shader, const Batch &batch)
+    {
+        if (batch.setUniforms)
+            batch.setUniforms(shader);
+        shader.setInt("drawData", DRAW_DATA_UNIT);
+        GLState::instance().bindTexture(DRAW_DATA_UNIT, GL_TEXTURE_BUFFER, drawDataTexture);
+        if (multiDraw)
+        {
+            functions().multiDrawElementsIndirect(GL_TRIANGLES, batch.indexType,
+                                                  (void*)(batch.firstCommand * sizeof(DrawCommand)),
+                                                  (GLsizei)batch.commandCount, 0);
+            return;
+        }
+        size_t indexSize = batch.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        for (unsigned int i = batch.firstCommand; i < batch.firstCommand + batch.commandCount; i++)
+        {
+            const DrawCommand &command = commands[i];
+            glVertexAttribI1ui(DRAW_INDEX_LOCATION, command.baseInstance);
+            glDrawElementsBaseVertex(GL_TRIANGLES, command.count, batch.indexType, (void*)(command.firstIndex * indexSize),
+                                     command.baseVertex);
+        }
+    }
+
+    // grows the aDrawIndex buffer to hold at least count draws. It is never empty, drawSlot's non-instanced
+    // draws still read instance 0 of it
+    void reserveDrawIndices(size_t count)
+    {
+        if (drawIndexCapacity >= count)
+            return;
+        while (drawIndexCapacity < count)
+            drawIndexCapacity = drawIndexCapacity ? drawIndexCapacity * 2 : 256;
+        std::vector<GLuint> indices(drawIndexCapacity);
+        for (size_t i = 0; i < indices.size(); i++)
+            indices[i] = (GLuint)i;
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    }
+
+    static size_t align(size_t offset)
+    {
+        return (offset + 3) & ~(size_t)3;
+    }
+
+    // the generated glad loader stops at 3.3, so the entry point is looked up on first use, with the context current
+    static const Functions &functions()
+    {
+        static Functions loaded = loadFunctions();
+        return loaded;
+    }
+
+    static Functions loadFunctions()
+    {
+        Functions loaded;
+        const char *setting = getenv("LEARNOPENGL_MULTI_DRAW");
+        if ((setting && strcmp(setting, "0") == 0) || !GLExtensions::hasMultiDrawIndirect())
+            return loaded;
+        loaded.multiDrawElementsIndirect = (MultiDrawElementsIndirectFunction)glfwGetProcAddress("glMultiDrawElementsIndirect");
+        return loaded;
+    }
+};
+#endif
@@ -0,0 +1,254 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Binary cache of already post-processed Assimp output. The cache for "<model>" lives next to it as
+// "<model>.meshcache" and is used only while the recorded source path, modification time, size, import
+// flags, post-import processing, vertex layout and format version all still match; otherwise the model is
+// imported again.
+//
+// layout (native endianness, little-endian on every platform we build for):
+//   header, source path bytes,
+//   per mesh: MeshHeader (with the bounds and diffuse color), vertices, indices, then per texture: type length, path length, type bytes, path bytes
+class MeshCache
+{
+public:
+    static const uint32_t MAGIC = 0x48534d52; // "RMSH"
+    static const uint32_t VERSION = 4;
+
+    static string cachePath(string const &sourcePath)
+    {
+        return sourcePath + ".meshcache";
+    }
+
+    // fills meshes from the cache file if it is fresh for the given source, import flags and processing,
+    // a bit set of whatever the caller does to the meshes after importing them (see Model::processingFlags)
+    static bool load(string const &sourcePath, unsigned int importFlags, unsigned int processing, vector<MeshData> &meshes)
+    {
+        SourceStamp stamp;
+        if (!stampSource(sourcePath, stamp))
+            return false;
+
+        int fd = open(cachePath(sourcePath).c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header))
+        {
+            close(fd);
+            return false;
+        }
+        size_t size = (size_t)st.st_size;
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+
+        Reader in((const char*)mapped, size);
+        bool ok = readContents(in, sourcePath, importFlags, processing, stamp, meshes);
+        munmap(mapped, size);
+        if (!ok)
+            meshes.clear();
+        return ok;
+    }
+
+    // writes the cache through a per-thread temporary file so concurrent readers never observe a partial cache
+    static bool store(string const &sourcePath, unsigned int importFlags, unsigned int processing, const vector<MeshData> &meshes)
+    {
+        SourceStamp stamp;
+        if (!stampSource(sourcePath, stamp))
+            return false;
+
+        string target = cachePath(sourcePath);
+        string temporary = target + ".tmp" + to_string(getpid()) + "." + to_string(hash<thread::id>()(this_thread::get_id()));
+        {
+            ofstream out(temporary, ios::binary | ios::trunc);
+            if (!out)
+                return false;
+
+            Header header;
+            header.magic = MAGIC;
+            header.version = VERSION;
+            header.importFlags = importFlags;
+            header.processing = processing;
+            header.vertexSize = sizeof(Vertex);
+            header.reserved = 0;
+            header.sourceMtime = stamp.mtime;
+            header.sourceSize = stamp.size;
+            header.pathLength = (uint32_t)sourcePath.size();
+            header.meshCount = (uint32_t)meshes.size();
+            out.write((const char*)&header, sizeof(header));
+            out.write(sourcePath.data(), sourcePath.size());
+
+            for (const MeshData &mesh : meshes)
+            {
+                MeshHeader meshHeader;
+                meshHeader.vertexCount = (uint32_t)mesh.vertices.size();
+                meshHeader.indexCount = (uint32_t)mesh.indices.size();
+                meshHeader.textureCount = (uint32_t)mesh.textures.size();
+                meshHeader.reserved = 0;
+                memcpy(meshHeader.boundsMin, &mesh.boundsMin[0], sizeof(meshHeader.boundsMin));
+                memcpy(meshHeader.boundsMax, &mesh.boundsMax[0], sizeof(meshHeader.boundsMax));
+                memcpy(meshHeader.diffuseColor, &mesh.diffuseColor[0], sizeof(meshHeader.diffuseColor));
+                out.write((const char*)&meshHeader, sizeof(meshHeader));
+                out.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+                out.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+                for (const TextureRef &texture : mesh.textures)
+                {
+                    uint32_t lengths[2] = { (uint32_t)texture.type.size(), (uint32_t)texture.path.size() };
+                    out.write((const char*)lengths, sizeof(lengths));
+                    out.write(texture.type.data(), texture.type.size());
+                    out.write(texture.path.data(), texture.path.size());
+                }
+            }
+            if (!out)
+            {
+                out.close();
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+        if (std::rename(temporary.c_str(), target.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t importFlags;
+        uint32_t processing;
+        uint32_t vertexSize;
+        uint32_t reserved;
+        int64_t  sourceMtime;
+        uint64_t sourceSize;
+        uint32_t pathLength;
+        uint32_t meshCount;
+    };
+
+    struct MeshHeader {
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t textureCount;
+        uint32_t reserved;
+        float    boundsMin[3];
+        float    boundsMax[3];
+        float    diffuseColor[3];
+    };
+
+    struct SourceStamp {
+        int64_t  mtime;
+        uint64_t size;
+    };
+
+    // bounds-checked cursor over the mapped file, a truncated or corrupt cache simply fails to load
+    struct Reader {
+        const char *cursor;
+        const char *end;
+
+        Reader(const char *data, size_t size) : cursor(data), end(data + size) {}
+
+        size_t remaining() const
+        {
+            return (size_t)(end - cursor);
+        }
+
+        bool read(void *destination, size_t size)
+        {
+            if (remaining() < size)
+                return false;
+            memcpy(destination, cursor, size);
+            cursor += size;
+            return true;
+        }
+
+        bool readString(string &destination, size_t size)
+        {
+            if (remaining() < size)
+                return false;
+            destination.assign(cursor, size);
+            cursor += size;
+            return true;
+        }
+    };
+
+    static bool stampSource(string const &sourcePath, SourceStamp &stamp)
+    {
+        struct stat st;
+        if (stat(sourcePath.c_str(), &st) != 0)
+            return false;
+        stamp.mtime = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        stamp.size = (uint64_t)st.st_size;
+        return true;
+    }
+
+    static bool readContents(Reader &in, string const &sourcePath, unsigned int importFlags, unsigned int processing,
+                             const SourceStamp &stamp, vector<MeshData> &meshes)
+    {
+        Header header;
+        if (!in.read(&header, sizeof(header)))
+            return false;
+        if (header.magic != MAGIC || header.version != VERSION || header.importFlags != importFlags
+            || header.processing != processing || header.vertexSize != sizeof(Vertex) || header.sourceMtime != stamp.mtime
+            || header.sourceSize != stamp.size)
+            return false;
+
+        string recordedPath;
+        if (!in.readString(recordedPath, header.pathLength) || recordedPath != sourcePath)
+            return false;
+
+        if (header.meshCount > in.remaining() / sizeof(MeshHeader))
+            return false;
+        meshes.resize(header.meshCount);
+        for (MeshData &mesh : meshes)
+        {
+            MeshHeader meshHeader;
+            if (!in.read(&meshHeader, sizeof(meshHeader)))
+                return false;
+            // counts are checked against the file size first so a corrupt header cannot trigger a huge allocation
+            if (meshHeader.vertexCount > in.remaining() / sizeof(Vertex)
+                || meshHeader.indexCount > in.remaining() / sizeof(unsigned int)
+                || meshHeader.textureCount > in.remaining() / (2 * sizeof(uint32_t)))
+                return false;
+            mesh.boundsMin = glm::vec3(meshHeader.boundsMin[0], meshHeader.boundsMin[1], meshHeader.boundsMin[2]);
+            mesh.boundsMax = glm::vec3(meshHeader.boundsMax[0], meshHeader.boundsMax[1], meshHeader.boundsMax[2]);
+            mesh.diffuseColor = glm::vec3(meshHeader.diffuseColor[0], meshHeader.diffuseColor[1], meshHeader.diffuseColor[2]);
+            mesh.vertices.resize(meshHeader.vertexCount);
+            mesh.indices.resize(meshHeader.indexCount);
+            if (!in.read(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex))
+                || !in.read(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int)))
+                return false;
+            mesh.textures.resize(meshHeader.textureCount);
+            for (TextureRef &texture : mesh.textures)
+            {
+                uint32_t lengths[2];
+                if (!in.read(lengths, sizeof(lengths))
+                    || !in.readString(texture.type, lengths[0])
+                    || !in.readString(texture.path, lengths[1]))
+                    return false;
+            }
+        }
+        return in.cursor == in.end;
+    }
+};
+#endif
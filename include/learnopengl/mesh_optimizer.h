@@ -0,0 +1,348 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Import-time optimization of one mesh's triangle list, run before the mesh cache is written:
+//   1. weld       merge vertices that are bitwise identical (OBJ imports get one vertex per face corner)
+//   2. cache      Forsyth's linear-speed vertex cache optimization, triangle order for post-transform reuse
+//   3. overdraw   split the cache-friendly order into clusters at cache flushes and draw outward facing,
+//                 outlying clusters first (Sander et al., "Fast Triangle Reordering"), kept only while ACMR
+//                 stays within OVERDRAW_THRESHOLD of the cache-optimized order
+//   4. fetch      renumber vertices in first-use order so vertex fetch walks memory linearly
+// Statistics use a 16-entry FIFO cache, the conservative model most hardware is at least as good as:
+// ACMR = vertex shader invocations per triangle (0.5 is ideal on a regular grid, 3 is no reuse),
+// ATVR = invocations per unique vertex (1 is ideal).
+class MeshOptimizer
+{
+public:
+    struct Stats {
+        size_t verticesBefore = 0;
+        size_t verticesAfter = 0;
+        size_t triangles = 0;
+        float acmrBefore = 0.0f;
+        float acmrAfter = 0.0f;
+        float atvrBefore = 0.0f;
+        float atvrAfter = 0.0f;
+        bool overdrawOrder = false; // whether the overdraw cluster order was kept
+    };
+
+    static const unsigned int CACHE_SIZE = 32;       // Forsyth's scoring cache
+    static const unsigned int FIFO_SIZE = 16;        // simulated cache for statistics and cluster boundaries
+    static constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+    static Stats optimize(MeshData &mesh)
+    {
+        Stats stats;
+        stats.verticesBefore = mesh.vertices.size();
+        stats.triangles = mesh.indices.size() / 3;
+        analyze(mesh.indices, mesh.vertices.size(), stats.acmrBefore, stats.atvrBefore);
+
+        weld(mesh);
+        // only triangle lists are reordered
+        if (mesh.indices.size() % 3 == 0 && !mesh.indices.empty())
+        {
+            optimizeVertexCache(mesh.indices, mesh.vertices.size());
+            stats.overdrawOrder = optimizeOverdraw(mesh.indices, mesh.vertices);
+        }
+        optimizeVertexFetch(mesh);
+
+        stats.verticesAfter = mesh.vertices.size();
+        analyze(mesh.indices, mesh.vertices.size(), stats.acmrAfter, stats.atvrAfter);
+        return stats;
+    }
+
+    // merges bitwise identical vertices and rewrites the indices accordingly
+    static void weld(MeshData &mesh)
+    {
+        struct VertexHash {
+            size_t operator()(const Vertex *vertex) const
+            {
+                // FNV-1a over the raw bytes, identical vertices compare equal bytewise as well
+                const unsigned char *bytes = (const unsigned char*)vertex;
+                size_t hash = 14695981039346656037ULL;
+                for (size_t i = 0; i < sizeof(Vertex); i++)
+                    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+                return hash;
+            }
+        };
+        struct VertexEqual {
+            bool operator()(const Vertex *a, const Vertex *b) const
+            {
+                return memcmp(a, b, sizeof(Vertex)) == 0;
+            }
+        };
+
+        vector<unsigned int> remap(mesh.vertices.size());
+        vector<Vertex> unique;
+        unique.reserve(mesh.vertices.size());
+        unordered_map<const Vertex*, unsigned int, VertexHash, VertexEqual> seen(mesh.vertices.size() * 2);
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+        {
+            auto inserted = seen.emplace(&mesh.vertices[i], (unsigned int)unique.size());
+            if (inserted.second)
+                unique.push_back(mesh.vertices[i]);
+            remap[i] = inserted.first->second;
+        }
+        for (unsigned int &index : mesh.indices)
+            index = remap[index];
+        mesh.vertices.swap(unique);
+    }
+
+    // Forsyth, "Linear-Speed Vertex Cache Optimisation": greedily emits the triangle with the best score, where
+    // vertices score high while recently used and while few triangles are left that still need them
+    static void optimizeVertexCache(vector<unsigned int> &indices, size_t vertexCount)
+    {
+        size_t triangleCount = indices.size() / 3;
+
+        // triangles using each vertex, as one flat adjacency list
+        vector<unsigned int> valence(vertexCount, 0);
+        for (unsigned int index : indices)
+            valence[index]++;
+        vector<unsigned int> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] = offsets[v] + valence[v];
+        vector<unsigned int> adjacency(indices.size());
+        vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[filled[indices[t * 3 + k]]++] = (unsigned int)t;
+
+        vector<int> cachePosition(vertexCount, -1);
+        vector<float> vertexScore(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            vertexScore[v] = scoreVertex(-1, valence[v]);
+        vector<float> triangleScore(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++)
+            triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        vector<bool> emitted(triangleCount, false);
+
+        vector<unsigned int> cache, nextCache;
+        cache.reserve(CACHE_SIZE + 3);
+        vector<unsigned int> result;
+        result.reserve(indices.size());
+        size_t scanCursor = 0;
+        long best = -1;
+
+        for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+        {
+            if (best < 0)
+            {
+                // nothing in the cache is connected to unemitted triangles, continue with the next one in input
+                // order; searching all of them for the best score would be quadratic on disjoint triangles
+                while (emitted[scanCursor])
+                    scanCursor++;
+                best = (long)scanCursor;
+            }
+
+            unsigned int triangle = (unsigned int)best;
+            emitted[triangle] = true;
+            const unsigned int *corners = &indices[triangle * 3];
+            result.insert(result.end(), corners, corners + 3);
+
+            // the triangle's vertices move to the front of the LRU cache, no longer needing it
+            nextCache.assign(corners, corners + 3);
+            for (unsigned int vertex : cache)
+                if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2])
+                    nextCache.push_back(vertex);
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int vertex = corners[k];
+                unsigned int *begin = &adjacency[offsets[vertex]];
+                unsigned int *end = begin + valence[vertex];
+                unsigned int *found = std::find(begin, end, triangle);
+                if (found != end)
+                {
+                    std::swap(*found, *(end - 1));
+                    valence[vertex]--;
+                }
+            }
+
+            // rescore everything that was in or just left the cache, and their triangles
+            for (size_t i = 0; i < nextCache.size(); i++)
+            {
+                unsigned int vertex = nextCache[i];
+                cachePosition[vertex] = i < CACHE_SIZE ? (int)i : -1;
+                vertexScore[vertex] = scoreVertex(cachePosition[vertex], valence[vertex]);
+            }
+            best = -1;
+            float bestScore = -1.0f;
+            for (size_t i = 0; i < nextCache.size(); i++)
+            {
+                unsigned int vertex = nextCache[i];
+                for (unsigned int a = 0; a < valence[vertex]; a++)
+                {
+                    unsigned int t = adjacency[offsets[vertex] + a];
+                    float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                    triangleScore[t] = score;
+                    if (score > bestScore)
+                    {
+                        best = (long)t;
+                        bestScore = score;
+                    }
+                }
+            }
+            if (nextCache.size() > CACHE_SIZE)
+                nextCache.resize(CACHE_SIZE);
+            cache.swap(nextCache);
+        }
+        indices.swap(result);
+    }
+
+    // reorders clusters of the cache-optimized triangle order so outward facing, outlying surfaces come first
+    // and occlude the rest. Returns false (leaving indices untouched) if that costs too much cache efficiency.
+    static bool optimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices)
+    {
+        size_t triangleCount = indices.size() / 3;
+
+        // hard cluster boundaries: triangles whose vertices all miss the cache, the order restarts there anyway
+        vector<size_t> clusterStart;
+        vector<unsigned int> fifo;
+        vector<unsigned int> cachedAt(vertices.size(), 0); // insertion stamp, 0 = never
+        unsigned int stamp = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            int misses = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int vertex = indices[t * 3 + k];
+                if (cachedAt[vertex] == 0 || stamp - cachedAt[vertex] >= FIFO_SIZE)
+                {
+                    cachedAt[vertex] = ++stamp;
+                    misses++;
+                }
+            }
+            if (misses == 3 || t == 0)
+                clusterStart.push_back(t);
+        }
+        if (clusterStart.size() < 2)
+            return false;
+        clusterStart.push_back(triangleCount);
+
+        // area weighted centroid and normal per cluster, and the mesh centroid
+        size_t clusterCount = clusterStart.size() - 1;
+        vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f));
+        vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            float clusterArea = 0.0f;
+            for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+            {
+                const glm::vec3 &a = vertices[indices[t * 3]].Position;
+                const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+                const glm::vec3 &p = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 normal = glm::cross(b - a, p - a);
+                float area = glm::length(normal);
+                glm::vec3 centroid = (a + b + p) / 3.0f;
+                clusterCentroid[c] += centroid * area;
+                clusterNormal[c] += normal;
+                clusterArea += area;
+                meshCentroid += centroid * area;
+                meshArea += area;
+            }
+            if (clusterArea > 0.0f)
+                clusterCentroid[c] /= clusterArea;
+        }
+        if (meshArea > 0.0f)
+            meshCentroid /= meshArea;
+
+        vector<float> sortKey(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            float length = glm::length(clusterNormal[c]);
+            glm::vec3 normal = length > 0.0f ? clusterNormal[c] / length : glm::vec3(0.0f);
+            sortKey[c] = glm::dot(clusterCentroid[c] - meshCentroid, normal);
+        }
+        vector<size_t> order(clusterCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+        vector<unsigned int> sorted;
+        sorted.reserve(indices.size());
+        for (size_t c : order)
+            sorted.insert(sorted.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+
+        float acmrBefore, acmrAfter, atvr;
+        analyze(indices, vertices.size(), acmrBefore, atvr);
+        analyze(sorted, vertices.size(), acmrAfter, atvr);
+        if (acmrAfter > acmrBefore * OVERDRAW_THRESHOLD)
+            return false;
+        indices.swap(sorted);
+        return true;
+    }
+
+    // renumbers vertices in the order the indices first use them, dropping unreferenced ones
+    static void optimizeVertexFetch(MeshData &mesh)
+    {
+        const unsigned int unused = ~0u;
+        vector<unsigned int> remap(mesh.vertices.size(), unused);
+        vector<Vertex> ordered;
+        ordered.reserve(mesh.vertices.size());
+        for (unsigned int &index : mesh.indices)
+        {
+            if (remap[index] == unused)
+            {
+                remap[index] = (unsigned int)ordered.size();
+                ordered.push_back(mesh.vertices[index]);
+            }
+            index = remap[index];
+        }
+        mesh.vertices.swap(ordered);
+    }
+
+    // ACMR and ATVR of an index list under a FIFO_SIZE entry FIFO cache
+    static void analyze(const vector<unsigned int> &indices, size_t vertexCount, float &acmr, float &atvr)
+    {
+        vector<unsigned int> cachedAt(vertexCount, 0);
+        vector<bool> referenced(vertexCount, false);
+        unsigned int stamp = 0;
+        size_t misses = 0, unique = 0;
+        for (unsigned int index : indices)
+        {
+            if (cachedAt[index] == 0 || stamp - cachedAt[index] >= FIFO_SIZE)
+            {
+                cachedAt[index] = ++stamp;
+                misses++;
+            }
+            if (!referenced[index])
+            {
+                referenced[index] = true;
+                unique++;
+            }
+        }
+        size_t triangles = indices.size() / 3;
+        acmr = triangles ? (float)misses / triangles : 0.0f;
+        atvr = unique ? (float)misses / unique : 0.0f;
+    }
+
+private:
+    static float scoreVertex(int cachePosition, unsigned int remainingTriangles)
+    {
+        // a vertex no triangle needs anymore is worth nothing
+        if (remainingTriangles == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            // the last triangle's vertices get a fixed score so the next triangle doesn't simply reuse its edge
+            if (cachePosition < 3)
+                score = 0.75f;
+            else
+                score = std::pow(1.0f - (float)(cachePosition - 3) / (CACHE_SIZE - 3), 1.5f);
+        }
+        // prefer vertices with few triangles left, finishing them frees cache entries for good
+        return score + 2.0f / std::sqrt((float)remainingTriangles);
+    }
+};
+#endif
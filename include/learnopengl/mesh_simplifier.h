@@ -0,0 +1,403 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Import-time reduction of one mesh's triangle list for coarser levels of detail (Garland and Heckbert, "Surface
+// Simplification Using Quadric Error Metrics"), by half-edge collapses: a vertex p moves onto a neighbour q,
+// removing the triangles on the edge between them. Collapses run cheapest first until the triangle target is met.
+//   - vertices are matched by position, so the copies an attribute seam (UV or normal discontinuity) splits
+//     a corner into move together; a collapse must carry every copy of p onto a copy of q along the seam,
+//     otherwise it is skipped and the seam keeps its shape
+//   - open borders are kept by extra planes through their edges, and border vertices only slide along them
+//   - collapses that would flip or degenerate a triangle, or make the surface non-manifold, are skipped
+// The result is reordered with MeshOptimizer for the vertex cache and vertex fetch.
+class MeshSimplifier
+{
+public:
+    struct Stats {
+        size_t trianglesBefore = 0;
+        size_t trianglesAfter = 0;
+        size_t verticesBefore = 0;
+        size_t verticesAfter = 0;
+        size_t collapses = 0;
+    };
+
+    static constexpr double BORDER_WEIGHT = 10.0;   // border planes against the area-weighted face planes
+    static constexpr float MIN_NORMAL_COSINE = 0.2f; // triangles may turn by less than about 78 degrees
+
+    // reduces mesh to about ratio of its triangles, or as far as the constraints above allow
+    static Stats simplify(MeshData &mesh, float ratio)
+    {
+        Stats stats;
+        stats.trianglesBefore = stats.trianglesAfter = mesh.indices.size() / 3;
+        stats.verticesBefore = stats.verticesAfter = mesh.vertices.size();
+        if (mesh.indices.empty() || mesh.indices.size() % 3 != 0 || ratio >= 1.0f)
+            return stats;
+
+        // the seams are found from the vertices, so bitwise copies must be one vertex first
+        MeshOptimizer::weld(mesh);
+        MeshSimplifier simplifier(mesh);
+        size_t target = (size_t)std::max(1.0, std::floor(stats.trianglesBefore * (double)std::max(ratio, 0.0f)));
+        stats.collapses = simplifier.run(target);
+        simplifier.write(mesh);
+
+        MeshOptimizer::optimizeVertexCache(mesh.indices, mesh.vertices.size());
+        MeshOptimizer::optimizeVertexFetch(mesh);
+        mesh.computeBounds();
+        stats.trianglesAfter = mesh.indices.size() / 3;
+        stats.verticesAfter = mesh.vertices.size();
+        return stats;
+    }
+
+private:
+    // symmetric 4x4 error quadric: error(v) = v^T A v + 2 b.v + c
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0, c = 0;
+
+        // squared distance to the plane n.v + d = 0 (n unit length) times weight
+        static Quadric plane(const glm::dvec3 &n, double d, double weight)
+        {
+            Quadric q;
+            q.a00 = weight * n.x * n.x; q.a01 = weight * n.x * n.y; q.a02 = weight * n.x * n.z;
+            q.a11 = weight * n.y * n.y; q.a12 = weight * n.y * n.z; q.a22 = weight * n.z * n.z;
+            q.b0 = weight * n.x * d; q.b1 = weight * n.y * d; q.b2 = weight * n.z * d;
+            q.c = weight * d * d;
+            return q;
+        }
+
+        Quadric &operator+=(const Quadric &o)
+        {
+            a00 += o.a00; a01 += o.a01; a02 += o.a02; a11 += o.a11; a12 += o.a12; a22 += o.a22;
+            b0 += o.b0; b1 += o.b1; b2 += o.b2; c += o.c;
+            return *this;
+        }
+
+        double error(const glm::dvec3 &v) const
+        {
+            double x = v.x, y = v.y, z = v.z;
+            return a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + a11 * y * y + 2.0 * a12 * y * z + a22 * z * z
+                   + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        }
+    };
+
+    // a candidate collapse of position from onto position to, stale once either's version moved on
+    struct Collapse {
+        double cost;
+        unsigned int from, to;
+        unsigned int fromVersion, toVersion;
+
+        bool operator<(const Collapse &o) const
+        {
+            return cost > o.cost; // cheapest on top of the priority_queue
+        }
+    };
+
+    vector<Vertex> &vertices;
+    vector<unsigned int> corners;            // three vertices per triangle, rewritten as collapses happen
+    vector<bool> triangleAlive;
+    size_t triangleCount;
+    vector<unsigned int> position;           // vertex -> position id
+    vector<glm::dvec3> positions;
+    vector<vector<unsigned int>> triangles;  // position -> triangles using it, may list dead ones
+    vector<Quadric> quadrics;
+    vector<unsigned int> versions;
+    vector<bool> positionAlive, border, locked;
+    unordered_map<uint64_t, unsigned int> edgeUses;  // triangles on each edge before any collapse
+    priority_queue<Collapse> queue;
+    vector<unsigned int> scratchP, scratchQ;
+
+    explicit MeshSimplifier(MeshData &mesh) : vertices(mesh.vertices), corners(mesh.indices),
+        triangleAlive(mesh.indices.size() / 3, true), triangleCount(mesh.indices.size() / 3)
+    {
+        weldPositions();
+        classifyEdges();
+        computeQuadrics();
+        for (size_t t = 0; t < triangleAlive.size(); t++)
+        {
+            for (int k = 0; k < 3 && triangleAlive[t]; k++)
+            {
+                unsigned int a = corner(t, k), b = corner(t, (k + 1) % 3);
+                push(a, b);
+                push(b, a);
+            }
+        }
+    }
+
+    unsigned int corner(size_t triangle, int k) const
+    {
+        return position[corners[triangle * 3 + k]];
+    }
+
+    // one id per distinct position, vertices differing only in other attributes share it
+    void weldPositions()
+    {
+        struct PositionHash {
+            size_t operator()(const glm::vec3 &p) const
+            {
+                uint32_t bits[3];
+                memcpy(bits, &p[0], sizeof(bits));
+                return ((size_t)bits[0] * 73856093u) ^ ((size_t)bits[1] * 19349663u) ^ ((size_t)bits[2] * 83492791u);
+            }
+        };
+        unordered_map<glm::vec3, unsigned int, PositionHash> ids(vertices.size() * 2);
+        position.resize(vertices.size());
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            auto inserted = ids.emplace(vertices[v].Position, (unsigned int)positions.size());
+            if (inserted.second)
+                positions.push_back(glm::dvec3(vertices[v].Position));
+            position[v] = inserted.first->second;
+        }
+        // triangles with two corners in one place cover nothing, they are dropped right away
+        triangles.resize(positions.size());
+        for (size_t t = 0; t < triangleAlive.size(); t++)
+        {
+            unsigned int a = corner(t, 0), b = corner(t, 1), c = corner(t, 2);
+            if (a == b || b == c || c == a)
+            {
+                triangleAlive[t] = false;
+                triangleCount--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+                triangles[corner(t, k)].push_back((unsigned int)t);
+        }
+        quadrics.resize(positions.size());
+        versions.assign(positions.size(), 0);
+        positionAlive.assign(positions.size(), true);
+        border.assign(positions.size(), false);
+        locked.assign(positions.size(), false);
+    }
+
+    static uint64_t edgeKey(unsigned int a, unsigned int b)
+    {
+        return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+    }
+
+    // positions on an edge of one triangle are border vertices, those on an edge of three or more never move
+    void classifyEdges()
+    {
+        unordered_map<uint64_t, unsigned int> uses(triangleCount * 3);
+        for (size_t t = 0; t < triangleAlive.size(); t++)
+            for (int k = 0; k < 3 && triangleAlive[t]; k++)
+                uses[edgeKey(corner(t, k), corner(t, (k + 1) % 3))]++;
+        for (const auto &edge : uses)
+        {
+            unsigned int a = (unsigned int)(edge.first >> 32), b = (unsigned int)edge.first;
+            if (edge.second == 1)
+                border[a] = border[b] = true;
+            else if (edge.second > 2)
+                locked[a] = locked[b] = true;
+        }
+        edgeUses.swap(uses);
+    }
+
+    void computeQuadrics()
+    {
+        for (size_t t = 0; t < triangleAlive.size(); t++)
+        {
+            if (!triangleAlive[t])
+                continue;
+            glm::dvec3 p[3] = { positions[corner(t, 0)], positions[corner(t, 1)], positions[corner(t, 2)] };
+            glm::dvec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+            double doubleArea = glm::length(normal);
+            if (doubleArea <= 0.0)
+                continue;
+            normal /= doubleArea;
+            Quadric face = Quadric::plane(normal, -glm::dot(normal, p[0]), doubleArea * 0.5);
+            for (int k = 0; k < 3; k++)
+                quadrics[corner(t, k)] += face;
+            // a plane through each border edge, perpendicular to the face, holds the outline in place
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = corner(t, k), b = corner(t, (k + 1) % 3);
+                if (edgeUses[edgeKey(a, b)] != 1)
+                    continue;
+                glm::dvec3 edge = p[(k + 1) % 3] - p[k];
+                glm::dvec3 edgeNormal = glm::cross(edge, normal);
+                double length = glm::length(edgeNormal);
+                if (length <= 0.0)
+                    continue;
+                edgeNormal /= length;
+                Quadric plane = Quadric::plane(edgeNormal, -glm::dot(edgeNormal, p[k]), BORDER_WEIGHT * glm::dot(edge, edge));
+                quadrics[a] += plane;
+                quadrics[b] += plane;
+            }
+        }
+    }
+
+    void push(unsigned int from, unsigned int to)
+    {
+        if (from == to || locked[from])
+            return;
+        Quadric combined = quadrics[from];
+        combined += quadrics[to];
+        queue.push(Collapse{ std::max(combined.error(positions[to]), 0.0), from, to, versions[from], versions[to] });
+    }
+
+    size_t run(size_t target)
+    {
+        size_t collapses = 0;
+        vector<pair<unsigned int, unsigned int>> wedges;
+        while (triangleCount > target && !queue.empty())
+        {
+            Collapse collapse = queue.top();
+            queue.pop();
+            unsigned int p = collapse.from, q = collapse.to;
+            if (!positionAlive[p] || !positionAlive[q] || versions[p] != collapse.fromVersion || versions[q] != collapse.toVersion)
+                continue;
+            if (!canCollapse(p, q, wedges))
+                continue;
+            collapseEdge(p, q, wedges);
+            collapses++;
+        }
+        return collapses;
+    }
+
+    // drops the dead triangles from a position's list and collects its neighbouring positions
+    void neighbours(unsigned int p, vector<unsigned int> &result)
+    {
+        vector<unsigned int> &list = triangles[p];
+        list.erase(std::remove_if(list.begin(), list.end(), [this](unsigned int t) { return !triangleAlive[t]; }), list.end());
+        result.clear();
+        for (unsigned int t : list)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int n = corner(t, k);
+                if (n != p && std::find(result.begin(), result.end(), n) == result.end())
+                    result.push_back(n);
+            }
+    }
+
+    // checks the collapse of p onto q and fills wedges with which vertex of q each vertex of p becomes
+    bool canCollapse(unsigned int p, unsigned int q, vector<pair<unsigned int, unsigned int>> &wedges)
+    {
+        vector<unsigned int> &around = scratchP, &aroundQ = scratchQ;
+        neighbours(p, around);
+        neighbours(q, aroundQ);
+
+        // the triangles on the edge pair p's vertices with q's; every vertex of p needs exactly one partner
+        wedges.clear();
+        size_t shared = 0;
+        for (unsigned int t : triangles[p])
+        {
+            int kp = -1, kq = -1;
+            for (int k = 0; k < 3; k++)
+            {
+                if (corner(t, k) == p)
+                    kp = k;
+                else if (corner(t, k) == q)
+                    kq = k;
+            }
+            if (kq < 0)
+                continue;
+            shared++;
+            unsigned int from = corners[t * 3 + kp], to = corners[t * 3 + kq];
+            auto known = std::find_if(wedges.begin(), wedges.end(), [from](const pair<unsigned int, unsigned int> &w) { return w.first == from; });
+            if (known == wedges.end())
+                wedges.push_back(std::make_pair(from, to));
+            else if (known->second != to)
+                return false;
+        }
+        // no longer neighbours, or on an edge between a border and an interior triangle fan
+        if (shared == 0 || (border[p] && shared != 1))
+            return false;
+        // link condition: the only positions both touch are the far corners of the edge's triangles
+        size_t common = 0;
+        for (unsigned int n : around)
+            if (n != q && std::find(aroundQ.begin(), aroundQ.end(), n) != aroundQ.end())
+                common++;
+        if (common != shared)
+            return false;
+
+        glm::dvec3 target = positions[q];
+        for (unsigned int t : triangles[p])
+        {
+            int kp = -1;
+            bool onEdge = false;
+            for (int k = 0; k < 3; k++)
+            {
+                if (corner(t, k) == p)
+                    kp = k;
+                else if (corner(t, k) == q)
+                    onEdge = true;
+            }
+            if (onEdge)
+                continue;
+            unsigned int from = corners[t * 3 + kp];
+            if (std::find_if(wedges.begin(), wedges.end(), [from](const pair<unsigned int, unsigned int> &w) { return w.first == from; }) == wedges.end())
+                return false; // a copy of p off the seam the edge follows
+            glm::dvec3 a = positions[corner(t, 0)], b = positions[corner(t, 1)], c = positions[corner(t, 2)];
+            glm::dvec3 before = glm::cross(b - a, c - a);
+            (kp == 0 ? a : kp == 1 ? b : c) = target;
+            glm::dvec3 after = glm::cross(b - a, c - a);
+            double lengths = glm::length(before) * glm::length(after);
+            if (lengths <= 0.0 || glm::dot(before, after) < MIN_NORMAL_COSINE * lengths)
+                return false;
+        }
+        return true;
+    }
+
+    void collapseEdge(unsigned int p, unsigned int q, const vector<pair<unsigned int, unsigned int>> &wedges)
+    {
+        for (unsigned int t : triangles[p])
+        {
+            bool onEdge = false;
+            for (int k = 0; k < 3; k++)
+                onEdge = onEdge || corner(t, k) == q;
+            if (onEdge)
+            {
+                triangleAlive[t] = false;
+                triangleCount--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int &vertex = corners[t * 3 + k];
+                if (position[vertex] != p)
+                    continue;
+                for (const pair<unsigned int, unsigned int> &wedge : wedges)
+                    if (wedge.first == vertex)
+                    {
+                        vertex = wedge.second;
+                        break;
+                    }
+            }
+            triangles[q].push_back(t);
+        }
+        triangles[p].clear();
+        positionAlive[p] = false;
+        quadrics[q] += quadrics[p];
+        versions[q]++;
+
+        vector<unsigned int> &around = scratchQ;
+        neighbours(q, around);
+        for (unsigned int n : around)
+        {
+            push(n, q);
+            push(q, n);
+        }
+    }
+
+    void write(MeshData &mesh)
+    {
+        vector<unsigned int> indices;
+        indices.reserve(triangleCount * 3);
+        for (size_t t = 0; t < triangleAlive.size(); t++)
+            if (triangleAlive[t])
+                indices.insert(indices.end(), corners.begin() + t * 3, corners.begin() + t * 3 + 3);
+        mesh.indices.swap(indices);
+    }
+};
+#endif
@@ -10,36 +10,99 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/instance_buffer.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_arena.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/render_queue.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_permutations.h>
+#include <learnopengl/texture_registry.h>
+#include <learnopengl/thread_pool.h>
 
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <future>
+#include <thread>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// CPU-side result of loading a model file, can be produced on any thread
+struct ModelData {
+    string path;
+    bool loaded = false;
+    vector<MeshData> meshes;
+};
 
 
 class Model
 {
 public:
+    // post-processing applied on import, part of the mesh cache key
+    static const unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+    // our own processing after the import, also part of the mesh cache key
+    static const unsigned int PROCESS_OPTIMIZE = 1 << 0;
+
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// every texture reference this model acquired from the TextureRegistry, released again on destruction
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    MeshOptions meshOptions;
+    // material settings for drawing through ShaderPermutations
+    float shininess = 32.0f;
+    bool normalMapping = true;  // false when the asset's bump maps are height maps rather than normal maps
+    InstanceBuffer instances;   // transforms of the last DrawInstanced
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false, MeshOptions options = MeshOptions()) : gammaCorrection(gamma), meshOptions(options)
     {
         loadModel(path);
     }
 
+    // creates the GL objects for model data read earlier, possibly on a worker thread. Must run on the context thread.
+    // the geometry is moved out of data into the meshes.
+    Model(ModelData &&data, bool gamma = false, MeshOptions options = MeshOptions()) : gammaCorrection(gamma), meshOptions(options)
+    {
+        createMeshes(data);
+    }
+
+    ~Model()
+    {
+        for (const Texture &texture : textures_loaded)
+            TextureRegistry::instance().release(texture.id);
+    }
+
+    // each model holds its own texture references, copies would release them twice. Moving into a new model is
+    // fine, assigning over an existing one would drop its references without releasing them
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+    Model(Model&&) = default;
+    Model& operator=(Model&&) = delete;
+
+    // starts reading the model at path on the pool, finish it on the context thread with Model(future.get()).
+    // the import options are applied here, the upload options once the Model is constructed
+    static std::future<ModelData> LoadAsync(ThreadPool &pool, string const &path, MeshOptions options = MeshOptions())
+    {
+        return pool.submit([path, options] { return ReadModelData(path, options); });
+    }
+
+    // CPU-only part of loading a model, see LoadMeshData
+    static ModelData ReadModelData(string const &path, const MeshOptions &options = MeshOptions())
+    {
+        ModelData data;
+        data.path = path;
+        data.loaded = LoadMeshData(path, data.meshes, options);
+        return data;
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
@@ -47,33 +110,250 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // draws count copies of the model, transforms[i] placing copy i, with one draw call per mesh. The shader reads
+    // the matrices from the instance attribute (InstanceBuffer), e.g. a lighting variant with instanced set
+    void DrawInstanced(Shader &shader, const glm::mat4 *transforms, size_t count)
+    {
+        if (count == 0)
+            return;
+        instances.update(transforms, count);
+        for (Mesh &mesh : meshes)
+        {
+            if (mesh.instanceBuffer != instances.id())
+            {
+                instances.attach(mesh.VAO);
+                mesh.instanceBuffer = instances.id();
+            }
+            mesh.DrawInstanced(shader, (GLsizei)count);
+        }
+    }
+
+    // draws every mesh with the cheapest lighting variant for it: features names the lights reaching the model
+    // (LightingFeatures::select), each mesh's textures decide the material maps
+    void Draw(ShaderPermutations &permutations, LightingFeatures features, const glm::mat4 &model)
+    {
+        for (Mesh &mesh : meshes)
+        {
+            features.specularMap = mesh.hasTexture("texture_specular");
+            features.normalMap = normalMapping && mesh.hasTexture("texture_normal");
+            ShaderPermutations::Variant &variant = permutations.get(features);
+            Shader &shader = *variant.shader;
+            shader.use();
+            shader.setMat4(variant.model, model);
+            shader.setFloat(variant.shininess, shininess);
+            for (int i = 0; i < features.pointLights; i++)
+                shader.setInt(variant.pointLightIndex[i], features.pointLightIndex[i]);
+            mesh.Draw(shader);
+        }
+    }
+
+    // queues every mesh like Draw(permutations, ...) does, depth is the model's distance from the camera
+    void Submit(RenderQueue &queue, ShaderPermutations &permutations, LightingFeatures features, const glm::mat4 &model, float depth)
+    {
+        for (const Mesh &mesh : meshes)
+            submitMesh(queue, permutations, features, mesh, model, depth);
+    }
+
+    // like Submit(queue, ...), except that meshes merged into arena join its batches for the frame and are drawn
+    // with the multiDraw variant of their lighting shader
+    void Submit(RenderQueue &queue, MeshArena &arena, ShaderPermutations &permutations, LightingFeatures features,
+                const glm::mat4 &model, float depth)
+    {
+        // what a batch sets once: the shininess and the slots of the point lights
+        uint32_t shininessBits;
+        memcpy(&shininessBits, &shininess, sizeof(shininessBits));
+        uint64_t key = (uint64_t)shininessBits << 32;
+        for (int i = 0; i < features.pointLights; i++)
+            key |= (uint64_t)(features.pointLightIndex[i] + 1) << (4 * i);
+
+        for (const Mesh &mesh : meshes)
+        {
+            if (mesh.arenaSlot < 0)
+            {
+                submitMesh(queue, permutations, features, mesh, model, depth);
+                continue;
+            }
+            LightingFeatures batched = features;
+            batched.specularMap = mesh.hasTexture("texture_specular");
+            batched.normalMap = normalMapping && mesh.hasTexture("texture_normal");
+            batched.multiDraw = true;
+            const ShaderPermutations::Variant &variant = permutations.get(batched);
+            MeshArena::Batch &batch = arena.batch(*variant.shader, mesh, key);
+            if (!batch.setUniforms)
+            {
+                float materialShininess = shininess;
+                batch.setUniforms = [&mesh, &variant, batched, materialShininess](Shader &shader) {
+                    shader.setFloat(variant.shininess, materialShininess);
+                    for (int i = 0; i < batched.pointLights; i++)
+                        shader.setInt(variant.pointLightIndex[i], batched.pointLightIndex[i]);
+                    mesh.SetUniforms(shader);
+                };
+            }
+            arena.add(batch, mesh, model, depth);
+        }
+    }
+
+    // adds every mesh to meshes, for MeshArena::build
+    void CollectMeshes(vector<Mesh*> &meshes)
+    {
+        for (Mesh &mesh : this->meshes)
+            meshes.push_back(&mesh);
+    }
+
+    // world space sphere around all meshes, for a model matrix without shear
+    void BoundingSphere(const glm::mat4 &model, glm::vec3 &center, float &radius) const
+    {
+        glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            boundsMin = i == 0 ? meshes[i].boundsMin : glm::min(boundsMin, meshes[i].boundsMin);
+            boundsMax = i == 0 ? meshes[i].boundsMax : glm::max(boundsMax, meshes[i].boundsMax);
+        }
+        center = glm::vec3(model * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+    }
+
+    // adds the bytes the meshes' index buffers take on the GPU, and what they would take with 32-bit indices
+    void IndexMemory(size_t &uploaded, size_t &unsignedInt) const
+    {
+        for (const Mesh &mesh : meshes)
+        {
+            uploaded += mesh.indexBytes();
+            unsignedInt += (size_t)mesh.indexCount * sizeof(unsigned int);
+        }
+    }
+
+    // triangles one draw of the model submits
+    size_t TriangleCount() const
+    {
+        size_t triangles = 0;
+        for (const Mesh &mesh : meshes)
+            triangles += mesh.indexCount / 3;
+        return triangles;
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
             mesh.glslIdentifierPrefix = prefix;
         }
     }
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+
+    // fills meshes with the CPU-side data of the model at path, from its binary cache when that is still fresh,
+    // otherwise through Assimp and ProcessMeshData, refreshing the cache afterwards. Touches no GL state.
+    static bool LoadMeshData(string const &path, vector<MeshData> &meshes, const MeshOptions &options = MeshOptions())
+    {
+        unsigned int processing = processingFlags(options);
+        if (MeshCache::load(path, IMPORT_FLAGS, processing, meshes))
+            return true;
+        if (!ImportMeshData(path, meshes))
+            return false;
+        ProcessMeshData(path, meshes, options);
+        if (!MeshCache::store(path, IMPORT_FLAGS, processing, meshes))
+            cout << "WARNING::MESH_CACHE:: could not write cache for " << path << endl;
+        return true;
+    }
+
+    // the mesh cache key for what ProcessMeshData does with the given options
+    static unsigned int processingFlags(const MeshOptions &options)
+    {
+        return options.optimize ? PROCESS_OPTIMIZE : 0;
+    }
+
+    // runs the import-time processing selected by options over freshly imported meshes
+    static void ProcessMeshData(string const &path, vector<MeshData> &meshes, const MeshOptions &options)
+    {
+        if (!options.optimize)
+            return;
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            MeshOptimizer::Stats stats = MeshOptimizer::optimize(meshes[i]);
+            // one string per line so lines from models optimized concurrently don't interleave
+            ostringstream line;
+            line.precision(3);
+            line << fixed << "MESH_OPTIMIZER:: " << path << " mesh " << i << ": " << stats.triangles << " triangles, "
+                 << stats.verticesBefore << " -> " << stats.verticesAfter << " vertices, ACMR " << stats.acmrBefore << " -> "
+                 << stats.acmrAfter << ", ATVR " << stats.atvrBefore << " -> " << stats.atvrAfter
+                 << (stats.overdrawOrder ? ", overdraw order" : "") << "\n";
+            cout << line.str() << flush;
+        }
+    }
+
+    // imports the model at path with Assimp, bypassing the cache
+    static bool ImportMeshData(string const &path, vector<MeshData> &meshes)
     {
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
+        // process ASSIMP's root node recursively
+        meshes.clear();
+        meshes.reserve(scene->mNumMeshes);
+        processNode(scene->mRootNode, scene, meshes);
+        return true;
+    }
+
+private:
+    // queues one mesh with the cheapest lighting variant for it, see Draw(permutations, ...)
+    void submitMesh(RenderQueue &queue, ShaderPermutations &permutations, LightingFeatures features, const Mesh &mesh,
+                    const glm::mat4 &model, float depth)
+    {
+        features.specularMap = mesh.hasTexture("texture_specular");
+        features.normalMap = normalMapping && mesh.hasTexture("texture_normal");
+        const ShaderPermutations::Variant &variant = permutations.get(features);
+        RenderQueue::Draw draw;
+        draw.shader = variant.shader;
+        draw.vao = mesh.VAO;
+        draw.depth = depth;
+        for (const Texture &texture : mesh.textures)
+            draw.addTexture(GL_TEXTURE_2D, texture.id);
+        float materialShininess = shininess;
+        draw.issue = [&mesh, &variant, features, model, materialShininess](Shader &shader) {
+            shader.setMat4(variant.model, model);
+            shader.setFloat(variant.shininess, materialShininess);
+            for (int i = 0; i < features.pointLights; i++)
+                shader.setInt(variant.pointLightIndex[i], features.pointLightIndex[i]);
+            mesh.SetUniforms(shader);
+            mesh.DrawElements();
+        };
+        queue.submit(std::move(draw));
+    }
+
+    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    void loadModel(string const &path)
+    {
+        ModelData data = ReadModelData(path, meshOptions);
+        createMeshes(data);
+    }
+
+    // GL part of loading: uploads every mesh and loads its material textures
+    void createMeshes(ModelData &data)
+    {
+        if (!data.loaded)
+            return;
         // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+        directory = data.path.substr(0, data.path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        meshes.reserve(data.meshes.size());
+        for (MeshData &mesh : data.meshes)
+        {
+            // model data assembled in code rather than imported comes without bounds
+            if (!mesh.hasBounds())
+                mesh.computeBounds();
+            meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.indices), loadMaterialTextures(mesh),
+                                mesh.boundsMin, mesh.boundsMax, meshOptions.packVertices);
+            if (!meshOptions.keepCPUData)
+                meshes.back().releaseCPUData();
+        }
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, vector<MeshData> &meshes)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -86,18 +366,20 @@ private:
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, meshes);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
-
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        // sized once up front, the faces are triangles after aiProcess_Triangulate
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve((size_t)mesh->mNumFaces * 3);
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
@@ -146,7 +428,7 @@ private:
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
+            const aiFace &face = mesh->mFaces[i];
             // retrieve all indices of the face and store them in the indices vector
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
@@ -161,99 +443,78 @@ private:
         // normal: texture_normalN
         aiColor3D color(0.0f, 0.0f, 0.0f);
         material->Get(AI_MATKEY_COLOR_AMBIENT, color);
+        aiColor3D diffuse(1.0f, 1.0f, 1.0f);
+        if (material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse) == aiReturn_SUCCESS)
+            data.diffuseColor = glm::vec3(diffuse.r, diffuse.g, diffuse.b);
 
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        collectMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data.textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        collectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", data.textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        collectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", data.textures);
 
+        // bounds for culling and vertex packing, cached with the geometry
+        data.computeBounds();
 
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data, GL objects are created from it later
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // records all material textures of a given type as references relative to the model directory
+    static void collectMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName, vector<TextureRef> &textures)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(TextureRef{typeName, str.C_Str()});
+        }
+    }
+
+    // acquires the referenced textures from the process-wide TextureRegistry, which loads each image only once
+    // no matter how many meshes or models refer to it. A mesh without a diffuse map gets a 1x1 texture of its
+    // material's diffuse color instead, so the lighting shaders need no untextured variant.
+    // the required info is returned as a Texture struct.
+    vector<Texture> loadMaterialTextures(const MeshData &mesh)
+    {
+        vector<Texture> textures;
+        bool diffuseMap = false;
+        for(const TextureRef &ref : mesh.textures)
+            diffuseMap = diffuseMap || ref.type == "texture_diffuse";
+        if (!diffuseMap)
+        {
+            Texture texture;
+            texture.id = TextureRegistry::instance().acquireColor(mesh.diffuseColor);
+            texture.type = "texture_diffuse";
+            textures.push_back(texture);
+            textures_loaded.push_back(texture);
+        }
+        for(const TextureRef &ref : mesh.textures)
+        {
+            Texture texture;
+            texture.id = TextureFromFile(ref.path.c_str(), this->directory);
+            texture.type = ref.type;
+            texture.path = ref.path;
+            textures.push_back(texture);
+            textures_loaded.push_back(texture);  // one entry per acquired reference, so the destructor releases each exactly once
         }
         return textures;
     }
 };
 
 
+// goes through the TextureRegistry, the caller owns one reference and releases it with TextureRegistry::release.
+// decoding happens on the shared TextureLoader's workers, the returned texture shows a placeholder until
+// TextureLoader::pump() uploads the real image
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return TextureRegistry::instance().acquire2D(filename);
 }
 #endif
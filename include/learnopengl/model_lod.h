@@ -0,0 +1,170 @@
+#ifndef MODEL_LOD_H
+#define MODEL_LOD_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/model.h>
+#include <learnopengl/thread_pool.h>
+
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Levels of detail of one object, level 0 the most detailed: authored versions of the asset (a HighRes and a
+// LowRes file), or levels the MeshSimplifier generates from one file on load. Each frame Select picks a level
+// from the height the object's bounding sphere covers on screen; level i takes over from level i - 1 below
+// switchSizes[i] pixels. A hysteresis band around every switch size keeps an object sitting right at one from
+// popping back and forth: it only goes coarser below switchSize * (1 - hysteresis) and finer above
+// switchSize * (1 + hysteresis).
+class ModelLOD
+{
+public:
+    static constexpr float DEFAULT_HYSTERESIS = 0.15f;
+    static constexpr float DEFAULT_FIRST_SWITCH = 256.0f; // pixels; each further level halves it
+
+    vector<float> switchSizes;  // switchSizes[0] is unused
+    float hysteresis = DEFAULT_HYSTERESIS;
+
+    // creates the GL objects of every level, most detailed first. Must run on the context thread.
+    ModelLOD(vector<ModelData> &&data, bool gamma = false, MeshOptions options = MeshOptions())
+    {
+        // the levels' meshes may be handed out by pointer (CollectMeshes), so the vector never reallocates
+        levels.reserve(data.size());
+        for (ModelData &level : data)
+            levels.emplace_back(std::move(level), gamma, options);
+        switchSizes.resize(levels.size(), 0.0f);
+        for (size_t i = 1; i < levels.size(); i++)
+            switchSizes[i] = DEFAULT_FIRST_SWITCH / (float)(1u << (i - 1));
+    }
+
+    // starts reading authored levels, one file per level and the most detailed first
+    static std::future<vector<ModelData>> LoadAsync(ThreadPool &pool, vector<string> paths, MeshOptions options = MeshOptions())
+    {
+        return pool.submit([paths, options] {
+            vector<ModelData> levels;
+            for (const string &path : paths)
+                levels.push_back(Model::ReadModelData(path, options));
+            return levels;
+        });
+    }
+
+    // starts reading path as level 0 and simplifying it to each of ratios of its triangles for the further levels.
+    // the generated levels are not cached, the mesh cache only keeps what was imported from path
+    static std::future<vector<ModelData>> LoadAsync(ThreadPool &pool, string const &path, vector<float> ratios,
+                                                    MeshOptions options = MeshOptions())
+    {
+        return pool.submit([path, ratios, options] {
+            vector<ModelData> levels;
+            levels.push_back(Model::ReadModelData(path, options));
+            for (float ratio : ratios)
+                levels.push_back(Simplify(levels.front(), ratio));
+            return levels;
+        });
+    }
+
+    // a copy of data with every mesh simplified to about ratio of its triangles. Touches no GL state.
+    static ModelData Simplify(const ModelData &data, float ratio)
+    {
+        ModelData simplified = data;
+        for (size_t i = 0; i < simplified.meshes.size(); i++)
+        {
+            MeshSimplifier::Stats stats = MeshSimplifier::simplify(simplified.meshes[i], ratio);
+            // one string per line so lines from models simplified concurrently don't interleave
+            ostringstream line;
+            line << "MESH_SIMPLIFIER:: " << data.path << " mesh " << i << " at " << ratio << ": " << stats.trianglesBefore
+                 << " -> " << stats.trianglesAfter << " triangles, " << stats.verticesBefore << " -> " << stats.verticesAfter
+                 << " vertices\n";
+            cout << line.str() << flush;
+        }
+        return simplified;
+    }
+
+    // pixels the sphere covers vertically on screen, huge once the eye is inside it
+    static float ScreenSize(const glm::vec3 &center, float radius, const glm::vec3 &eye, const glm::mat4 &projection,
+                            float viewportHeight)
+    {
+        float distance = glm::length(center - eye);
+        if (distance <= radius)
+            return INFINITY;
+        return radius * projection[1][1] * viewportHeight / distance;
+    }
+
+    // the level for an object covering size pixels that used current last frame, -1 for none (no hysteresis)
+    int SelectLevel(float size, int current) const
+    {
+        int count = (int)levels.size();
+        if (current < 0 || current >= count)
+        {
+            int level = 0;
+            while (level + 1 < count && size < switchSizes[level + 1])
+                level++;
+            return level;
+        }
+        int level = current;
+        while (level + 1 < count && size < switchSizes[level + 1] * (1.0f - hysteresis))
+            level++;
+        while (level > 0 && size > switchSizes[level] * (1.0f + hysteresis))
+            level--;
+        return level;
+    }
+
+    // picks the level for the object placed by model, seen from eye, and remembers it for the next frame.
+    // one ModelLOD drawn at several places needs SelectLevel with a current level per place instead
+    Model &Select(const glm::mat4 &model, const glm::vec3 &eye, const glm::mat4 &projection, float viewportHeight)
+    {
+        glm::vec3 center;
+        float radius;
+        levels.front().BoundingSphere(model, center, radius);
+        int level = SelectLevel(ScreenSize(center, radius, eye, projection, viewportHeight), current);
+        if (current >= 0 && level != current)
+            switches++;
+        current = level;
+        return levels[level];
+    }
+
+    Model &Level(int level)
+    {
+        return levels[level];
+    }
+
+    int LevelCount() const
+    {
+        return (int)levels.size();
+    }
+
+    // the level the last Select picked, -1 before the first
+    int CurrentLevel() const
+    {
+        return current;
+    }
+
+    // how often Select changed level
+    unsigned int Switches() const
+    {
+        return switches;
+    }
+
+    void SetShaderTextureNamePrefix(std::string prefix)
+    {
+        for (Model &level : levels)
+            level.SetShaderTextureNamePrefix(prefix);
+    }
+
+    // adds every level's meshes to meshes, for MeshArena::build
+    void CollectMeshes(vector<Mesh*> &meshes)
+    {
+        for (Model &level : levels)
+            level.CollectMeshes(meshes);
+    }
+
+private:
+    vector<Model> levels;
+    int current = -1;
+    unsigned int switches = 0;
+};
+#endif
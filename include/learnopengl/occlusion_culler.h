@@ -0,0 +1,367 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mesh_arena.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader_manager.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Hierarchical Z occlusion culling on the GPU with one frame of latency. Each frame the large occluders are
+// drawn depth only into a small target, which is reduced into a mip chain where every texel keeps the farthest
+// depth of the four below it. Every object's bounding sphere is then tested against the level where its screen
+// rectangle covers at most 2x2 texels, one point per object into a row of results, and that row is read back
+// through a pixel pack buffer guarded by a fence.
+//
+// A frame draws with the newest results the GPU has finished, usually those of the previous frame; objects are
+// identified by the order add() is called in, so every frame must add the same objects in the same order. An
+// object without a finished result is visible, as is everything while the culler is unavailable (incomplete
+// framebuffer, LEARNOPENGL_OCCLUSION=0). Nothing waits on the GPU, so a slow or software rasterizer only
+// delays the results; under llvmpipe and similar the depth target is halved in both directions as the occluder
+// pass runs on the CPU there.
+class OcclusionCuller
+{
+public:
+    static const int MAX_OBJECTS = 1024;
+    // readbacks in flight, the GPU may run this many frames behind before results are dropped
+    static const int RESULT_SLOTS = 3;
+
+    struct FrameStats {
+        unsigned int occluders = 0;
+        unsigned int tested = 0;    // objects with a finished result
+        unsigned int occluded = 0;  // of those, hidden by the occluders
+        unsigned int pending = 0;   // objects drawn because no result was ready
+    };
+
+    // shaderDirectory holds occlusion_depth, hiz_downsample and occlusion_test (.vs/.fs); width x height is
+    // the resolution of the occluder depth, rounded up to powers of two
+    OcclusionCuller(ShaderManager &shaders, const std::string &shaderDirectory, int width = 256, int height = 128)
+        : depthShader(shaders.load(shaderDirectory + "occlusion_depth.vs", shaderDirectory + "occlusion_depth.fs")),
+          downsampleShader(shaders.load(shaderDirectory + "hiz_downsample.vs", shaderDirectory + "hiz_downsample.fs")),
+          testShader(shaders.load(shaderDirectory + "occlusion_test.vs", shaderDirectory + "occlusion_test.fs"))
+    {
+        const char *setting = getenv("LEARNOPENGL_OCCLUSION");
+        if (setting && strcmp(setting, "0") == 0)
+            return;
+        const char *renderer = (const char *)glGetString(GL_RENDERER);
+        if (renderer && (strstr(renderer, "llvmpipe") || strstr(renderer, "softpipe") || strstr(renderer, "SwiftShader")))
+        {
+            width /= 2;
+            height /= 2;
+        }
+        hiZWidth = powerOfTwo(width);
+        hiZHeight = powerOfTwo(height);
+        while ((std::max(hiZWidth, hiZHeight) >> hiZLevels) > 0)
+            hiZLevels++;
+        available = createTargets();
+        if (available)
+            std::cout << "Occlusion culling: " << hiZWidth << "x" << hiZHeight << " hierarchical Z, " << hiZLevels
+                      << " levels" << std::endl;
+        else
+            std::cout << "WARNING::OCCLUSION_CULLER::FRAMEBUFFER_INCOMPLETE everything is drawn" << std::endl;
+    }
+
+    ~OcclusionCuller()
+    {
+        GLState &state = GLState::instance();
+        for (ResultSlot &slot : slots)
+        {
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+            if (slot.buffer)
+                state.deleteBuffer(slot.buffer);
+        }
+        if (sphereBuffer)
+            state.deleteBuffer(sphereBuffer);
+        for (GLuint vao : { sphereVAO, emptyVAO })
+        {
+            if (vao)
+                state.deleteVertexArray(vao);
+        }
+        for (GLuint texture : { hiZ, resultTexture })
+        {
+            if (texture)
+                state.deleteTexture(texture);
+        }
+        GLuint framebuffers[] = { depthFramebuffer, resultFramebuffer };
+        glDeleteFramebuffers(2, framebuffers);
+    }
+
+    OcclusionCuller(const OcclusionCuller &) = delete;
+    OcclusionCuller &operator=(const OcclusionCuller &) = delete;
+
+    bool isAvailable() const
+    {
+        return available;
+    }
+
+    // takes the newest finished results and starts collecting the frame's occluders and objects
+    void begin()
+    {
+        spheres.clear();
+        occluders.clear();
+        current = FrameStats();
+        if (available)
+            collectResults();
+    }
+
+    // draws model with transform into the occluder depth; its meshes merged into arena are drawn from there
+    void addOccluder(const Model &model, const glm::mat4 &transform, const MeshArena *arena = nullptr)
+    {
+        occluders.push_back({ &model, arena, transform });
+    }
+
+    // queues the world space sphere for this frame's test and returns whether to draw the object: false only
+    // when the newest finished result for the same object found it hidden
+    bool add(const glm::vec3 &center, float radius)
+    {
+        size_t index = spheres.size();
+        if (!available || index >= (size_t)MAX_OBJECTS)
+            return true;
+        spheres.push_back(glm::vec4(center, radius));
+        if (index >= results.size())
+        {
+            current.pending++;
+            return true;
+        }
+        current.tested++;
+        if (results[index])
+            return true;
+        current.occluded++;
+        return false;
+    }
+
+    // draws the occluders, builds the hierarchical Z and tests the frame's objects with the Camera block's
+    // matrices, then starts reading the results back. Restores the framebuffer and viewport.
+    FrameStats render()
+    {
+        current.occluders = (unsigned int)occluders.size();
+        if (!available || spheres.empty())
+            return current;
+        GLState &state = GLState::instance();
+        GLint previousFramebuffer, viewport[4];
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        // occluder depth into level 0
+        glBindFramebuffer(GL_FRAMEBUFFER, depthFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, hiZ, 0);
+        glViewport(0, 0, hiZWidth, hiZHeight);
+        state.setDepthTest(true);
+        state.setDepthMask(true);
+        state.setDepthFunc(GL_LESS);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        depthShader.use();
+        for (const Occluder &occluder : occluders)
+        {
+            depthShader.setMat4("model", occluder.transform);
+            for (const Mesh &mesh : occluder.model->meshes)
+            {
+                mesh.SetUniforms(depthShader);
+                if (occluder.arena && mesh.arenaSlot >= 0)
+                {
+                    state.bindVertexArray(occluder.arena->vertexArray());
+                    occluder.arena->drawSlot(mesh.arenaSlot);
+                    continue;
+                }
+                state.bindVertexArray(mesh.VAO);
+                mesh.DrawElements();
+            }
+        }
+
+        // each level from the one below, which is all the sampler sees meanwhile
+        state.setDepthFunc(GL_ALWAYS);
+        downsampleShader.use();
+        downsampleShader.setInt("depth", 0);
+        // active as well as bound, the level range is set on it below
+        state.activeTexture(0);
+        state.bindTexture(GL_TEXTURE_2D, hiZ);
+        state.bindVertexArray(emptyVAO);
+        for (int level = 1; level < hiZLevels; level++)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, hiZ, level);
+            glViewport(0, 0, std::max(hiZWidth >> level, 1), std::max(hiZHeight >> level, 1));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, hiZLevels - 1);
+        state.setDepthFunc(GL_LESS);
+
+        // one point per object into the result row; the row has no depth buffer, so the depth test passes
+        glBindFramebuffer(GL_FRAMEBUFFER, resultFramebuffer);
+        glViewport(0, 0, MAX_OBJECTS, 1);
+        state.bindBuffer(GL_ARRAY_BUFFER, sphereBuffer);
+        glBufferData(GL_ARRAY_BUFFER, spheres.size() * sizeof(glm::vec4), spheres.data(), GL_STREAM_DRAW);
+        testShader.use();
+        testShader.setInt("hiZ", 0);
+        testShader.setInt("hiZLevels", hiZLevels);
+        testShader.setFloat("resultWidth", (float)MAX_OBJECTS);
+        state.bindVertexArray(sphereVAO);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)spheres.size());
+
+        // read back into the next slot; if the GPU is still behind on it those results are dropped
+        ResultSlot &slot = slots[nextSlot];
+        nextSlot = (nextSlot + 1) % RESULT_SLOTS;
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        state.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, (GLsizei)spheres.size(), 1, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+        state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.count = spheres.size();
+        slot.frame = ++frame;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        return current;
+    }
+
+private:
+    struct Occluder {
+        const Model *model;
+        const MeshArena *arena;
+        glm::mat4 transform;
+    };
+
+    struct ResultSlot {
+        GLuint buffer = 0;
+        GLsync fence = 0;
+        size_t count = 0;
+        unsigned long frame = 0;  // render() call that wrote it
+    };
+
+    Shader &depthShader;
+    Shader &downsampleShader;
+    Shader &testShader;
+    bool available = false;
+    int hiZWidth = 0, hiZHeight = 0, hiZLevels = 0;
+    GLuint hiZ = 0, depthFramebuffer = 0;
+    GLuint resultTexture = 0, resultFramebuffer = 0;
+    GLuint sphereVAO = 0, sphereBuffer = 0, emptyVAO = 0;
+    ResultSlot slots[RESULT_SLOTS];
+    int nextSlot = 0;
+    unsigned long frame = 0;
+    std::vector<glm::vec4> spheres;
+    std::vector<Occluder> occluders;
+    std::vector<uint8_t> results;  // of the newest finished slot, nonzero for visible
+    FrameStats current;
+
+    static int powerOfTwo(int value)
+    {
+        int size = 1;
+        while (size < value)
+            size <<= 1;
+        return size;
+    }
+
+    // false when either framebuffer is incomplete
+    bool createTargets()
+    {
+        GLState &state = GLState::instance();
+        GLint previousFramebuffer;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+        // the depth chain, sampled without comparison
+        glGenTextures(1, &hiZ);
+        state.activeTexture(0);
+        state.bindTexture(GL_TEXTURE_2D, hiZ);
+        for (int level = 0; level < hiZLevels; level++)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_DEPTH_COMPONENT32F, std::max(hiZWidth >> level, 1),
+                         std::max(hiZHeight >> level, 1), 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, hiZLevels - 1);
+        glGenFramebuffers(1, &depthFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, depthFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, hiZ, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+        // the result row, one byte per object
+        glGenTextures(1, &resultTexture);
+        state.bindTexture(GL_TEXTURE_2D, resultTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, MAX_OBJECTS, 1, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenFramebuffers(1, &resultFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, resultFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resultTexture, 0);
+        complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+
+        // spheres at location 0; the downsample pass draws without attributes
+        glGenVertexArrays(1, &sphereVAO);
+        glGenBuffers(1, &sphereBuffer);
+        state.bindVertexArray(sphereVAO);
+        state.bindBuffer(GL_ARRAY_BUFFER, sphereBuffer);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glGenVertexArrays(1, &emptyVAO);
+        state.bindVertexArray(0);
+
+        for (ResultSlot &slot : slots)
+        {
+            glGenBuffers(1, &slot.buffer);
+            state.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, MAX_OBJECTS, nullptr, GL_STREAM_READ);
+        }
+        state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return complete;
+    }
+
+    // copies the results of the newest slot the GPU has finished, without waiting; older ones are released
+    void collectResults()
+    {
+        ResultSlot *newest = nullptr;
+        for (ResultSlot &slot : slots)
+        {
+            if (!slot.fence)
+                continue;
+            GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                continue;
+            if (!newest || slot.frame > newest->frame)
+                newest = &slot;
+        }
+        if (!newest)
+            return;
+        GLState &state = GLState::instance();
+        state.bindBuffer(GL_PIXEL_PACK_BUFFER, newest->buffer);
+        const void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, newest->count, GL_MAP_READ_BIT);
+        if (mapped)
+        {
+            const uint8_t *bytes = (const uint8_t *)mapped;
+            results.assign(bytes, bytes + newest->count);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        // finished slots no newer than the one read are done with
+        unsigned long readFrame = newest->frame;
+        for (ResultSlot &slot : slots)
+        {
+            if (slot.fence && slot.frame <= readFrame)
+            {
+                glDeleteSync(slot.fence);
+                slot.fence = 0;
+            }
+        }
+    }
+};
+#endif
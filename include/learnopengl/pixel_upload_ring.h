@@ -0,0 +1,218 @@
+#ifndef PIXEL_UPLOAD_RING_H
+#define PIXEL_UPLOAD_RING_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+// Streams texture uploads through a small ring of pixel unpack buffers instead of handing client memory to
+// glTexImage2D. Pixels are copied into the next buffer of the ring and glTexSubImage2D sources them from there,
+// so the driver can schedule the transfer instead of copying synchronously inside the call. A fence per buffer
+// guards its reuse. The buffers are created lazily on the first upload and keep their size between uploads.
+class PixelUploadRing
+{
+public:
+    struct FrameStats {
+        size_t bytes = 0;             // pixel bytes uploaded during the frame
+        unsigned int uploads = 0;
+        double submitMs = 0.0;        // CPU time spent inside upload()
+        double fenceWaitMs = 0.0;     // part of submitMs spent waiting for a ring buffer to become free
+        double directEstimateMs = 0.0; // what the same bytes would have cost through client-memory glTexImage2D
+
+        double savedMs() const
+        {
+            return directEstimateMs - submitMs;
+        }
+    };
+
+    explicit PixelUploadRing(unsigned int slotCount = 4) : slots(slotCount) {}
+
+    // false sends uploads through the old client-memory path, for comparison
+    void setEnabled(bool enable)
+    {
+        enabled = enable;
+    }
+
+    bool isEnabled() const
+    {
+        return enabled;
+    }
+
+    // specifies one level of image target (bound by the caller) with width x height tightly packed pixels
+    void upload(GLenum target, GLint level, GLint internalFormat, int width, int height, GLenum format, const void *pixels, size_t size)
+    {
+        if (directMsPerByte < 0.0)
+            calibrateDirectPath();
+        auto start = std::chrono::steady_clock::now();
+
+        GLint previousAlignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        if (enabled)
+        {
+            Slot &slot = acquireSlot();
+            // storage is allocated with no unpack buffer bound so the null pointer really means "no data"
+            glTexImage2D(target, level, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+            bool staged = stage(slot, pixels, size);
+            if (staged)
+            {
+                glTexSubImage2D(target, level, 0, 0, width, height, format, GL_UNSIGNED_BYTE, (void*)0);
+                slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
+            // an unpack buffer left bound would turn every later client-memory pointer into a buffer offset
+            GLState::instance().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            if (!staged)
+                glTexSubImage2D(target, level, 0, 0, width, height, format, GL_UNSIGNED_BYTE, pixels);
+        }
+        else
+        {
+            glTexImage2D(target, level, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+        record(start, size);
+    }
+
+    // same for one level of block compressed data, size bytes of blocks in internalFormat
+    void uploadCompressed(GLenum target, GLint level, GLenum internalFormat, int width, int height, const void *blocks, size_t size)
+    {
+        if (directMsPerByte < 0.0)
+            calibrateDirectPath();
+        auto start = std::chrono::steady_clock::now();
+
+        if (enabled)
+        {
+            Slot &slot = acquireSlot();
+            bool staged = stage(slot, blocks, size);
+            if (staged)
+            {
+                // compressed storage can't be allocated empty, so the whole level is specified from the buffer
+                glCompressedTexImage2D(target, level, internalFormat, width, height, 0, (GLsizei)size, (void*)0);
+                slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
+            GLState::instance().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            if (!staged)
+                glCompressedTexImage2D(target, level, internalFormat, width, height, 0, (GLsizei)size, blocks);
+        }
+        else
+        {
+            glCompressedTexImage2D(target, level, internalFormat, width, height, 0, (GLsizei)size, blocks);
+        }
+
+        record(start, size);
+    }
+
+    // returns the counters of the frame that just ended and starts a new one
+    FrameStats endFrame()
+    {
+        FrameStats finished = current;
+        current = FrameStats();
+        return finished;
+    }
+
+    // deletes the buffers and pending fences, with the context still current; the ring is owned by the
+    // TextureLoader singleton, which outlives glfwTerminate. Later uploads create the buffers again.
+    void release()
+    {
+        for (Slot &slot : slots)
+        {
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+            if (slot.buffer)
+                GLState::instance().deleteBuffer(slot.buffer);
+            slot = Slot();
+        }
+        next = 0;
+    }
+
+private:
+    struct Slot {
+        unsigned int buffer = 0;
+        size_t capacity = 0;
+        GLsync fence = 0;
+    };
+
+    std::vector<Slot> slots;
+    size_t next = 0;
+    bool enabled = true;
+    double directMsPerByte = -1.0;
+    FrameStats current;
+
+    // the next buffer of the ring, once the GPU has finished reading it
+    Slot& acquireSlot()
+    {
+        Slot &slot = slots[next];
+        next = (next + 1) % slots.size();
+        if (slot.buffer == 0)
+            glGenBuffers(1, &slot.buffer);
+        if (slot.fence)
+        {
+            auto waitStart = std::chrono::steady_clock::now();
+            glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, ~GLuint64(0));
+            current.fenceWaitMs += millisecondsSince(waitStart);
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+        }
+        return slot;
+    }
+
+    // binds the slot as unpack buffer and copies the data in; false when the buffer could not be mapped
+    bool stage(Slot &slot, const void *data, size_t size)
+    {
+        GLState::instance().bindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        if (slot.capacity < size)
+        {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+            slot.capacity = size;
+        }
+        // acquireSlot() guarantees the GPU is done with this buffer, no need for the driver to synchronize
+        void *staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!staging)
+            return false;
+        memcpy(staging, data, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        return true;
+    }
+
+    void record(std::chrono::steady_clock::time_point start, size_t size)
+    {
+        double elapsed = millisecondsSince(start);
+        if (!enabled)
+            directMsPerByte = elapsed / (double)size;
+        current.bytes += size;
+        current.uploads++;
+        current.submitMs += elapsed;
+        current.directEstimateMs += directMsPerByte * (double)size;
+    }
+
+    static double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // times one client-memory upload into a scratch texture so savings can be estimated while the ring is used
+    void calibrateDirectPath()
+    {
+        const int size = 512;
+        std::vector<unsigned char> pixels((size_t)size * size * 4, 128);
+        // runs inside the first upload, after the caller bound its texture on the same unit
+        GLint previousTexture;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+        unsigned int scratch;
+        glGenTextures(1, &scratch);
+        GLState::instance().bindTexture(GL_TEXTURE_2D, scratch);
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        directMsPerByte = millisecondsSince(start) / (double)pixels.size();
+        GLState::instance().deleteTexture(scratch);
+        GLState::instance().bindTexture(GL_TEXTURE_2D, (GLuint)previousTexture);
+    }
+};
+#endif
@@ -0,0 +1,229 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/gl_extensions.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary, core in 4.1 and
+// ARB_get_program_binary before that). A binary is stored as "<shader dir>/.programcache/<key>.bin", where the
+// key hashes the shader sources, the defines they were built with and the driver's vendor, renderer and
+// version strings, so editing a shader or updating the driver simply misses the cache. A binary the driver
+// rejects anyway is deleted and the program is compiled from source.
+//
+// Set LEARNOPENGL_PROGRAM_CACHE=0 in the environment to always compile from source, e.g. to compare start-up.
+class ProgramCache
+{
+public:
+    static const uint32_t MAGIC = 0x42475052; // "RPGB"
+    static const uint32_t VERSION = 1;
+
+    struct Stats {
+        unsigned int hits = 0;       // programs created from a cached binary
+        unsigned int misses = 0;     // programs compiled from source
+        unsigned int rejected = 0;   // cached binaries the driver refused
+        double loadMs = 0.0;         // time spent restoring the hits
+    };
+
+    // hash of everything a program binary depends on, as 16 hex digits
+    static std::string key(const std::string &vertexCode, const std::string &fragmentCode,
+                           const std::string &geometryCode = "", const std::string &defines = "")
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        auto mix = [&hash](const char *data, size_t size) {
+            for (size_t i = 0; i < size; i++)
+                hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+            // a separator, so moving text from one string to the next changes the key
+            hash = (hash ^ 0xff) * 1099511628211ULL;
+        };
+        for (const std::string *source : { &vertexCode, &fragmentCode, &geometryCode })
+            mix(source->data(), source->size());
+        mix(defines.data(), defines.size());
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+        {
+            const char *value = (const char*)glGetString(name);
+            mix(value ? value : "", value ? strlen(value) : 0);
+        }
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+        return hex;
+    }
+
+    // a linked program restored from the cache, or 0 when there is no usable binary for key
+    static GLuint load(const std::string &vertexPath, const std::string &key)
+    {
+        if (!functions().available)
+            return 0;
+        auto start = std::chrono::steady_clock::now();
+        std::string path = cachePath(vertexPath, key);
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return 0;
+        Header header;
+        std::vector<char> binary;
+        if (in.read((char*)&header, sizeof(header)) && header.magic == MAGIC && header.version == VERSION)
+            binary.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        in.close();
+        if (binary.empty() || binary.size() != header.length)
+        {
+            std::remove(path.c_str());
+            return 0;
+        }
+
+        GLuint program = glCreateProgram();
+        functions().programBinary(program, (GLenum)header.format, binary.data(), (GLsizei)binary.size());
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            glDeleteProgram(program);
+            std::remove(path.c_str());
+            counters().rejected++;
+            return 0;
+        }
+        counters().hits++;
+        counters().loadMs += millisecondsSince(start);
+        return program;
+    }
+
+    // a new program to compile from source, marked so the driver keeps its binary retrievable for store()
+    static GLuint create()
+    {
+        GLuint program = glCreateProgram();
+        if (functions().available)
+            functions().programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        return program;
+    }
+
+    // records a program compiled from source after it linked successfully. Written through a temporary file
+    // and renamed, like the mesh cache, so a crash never leaves half a binary.
+    static bool store(const std::string &vertexPath, const std::string &key, GLuint program)
+    {
+        counters().misses++;
+        if (!functions().available)
+            return false;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        functions().getProgramBinary(program, length, &written, &format, binary.data());
+        if (written <= 0)
+            return false;
+
+        mkdir(cacheDirectory(vertexPath).c_str(), 0755);
+        std::string target = cachePath(vertexPath, key);
+        std::string temporary = target + ".tmp" + std::to_string(getpid());
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+            Header header = { MAGIC, VERSION, (uint32_t)format, (uint32_t)written };
+            out.write((const char*)&header, sizeof(header));
+            out.write(binary.data(), written);
+            if (!out)
+            {
+                out.close();
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+        if (std::rename(temporary.c_str(), target.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    static Stats stats()
+    {
+        return counters();
+    }
+
+private:
+    typedef void (APIENTRY *GetProgramBinaryFunction)(GLuint, GLsizei, GLsizei*, GLenum*, void*);
+    typedef void (APIENTRY *ProgramBinaryFunction)(GLuint, GLenum, const void*, GLsizei);
+    typedef void (APIENTRY *ProgramParameteriFunction)(GLuint, GLenum, GLint);
+
+    struct Functions {
+        bool available = false;
+        GetProgramBinaryFunction getProgramBinary = nullptr;
+        ProgramBinaryFunction programBinary = nullptr;
+        ProgramParameteriFunction programParameteri = nullptr;
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t format;
+        uint32_t length;
+    };
+
+    static Stats &counters()
+    {
+        static Stats stats;
+        return stats;
+    }
+
+    // the generated glad loader stops at 3.3, so the entry points are looked up here on first use, which has
+    // to happen with the context current
+    static const Functions &functions()
+    {
+        static Functions loaded = loadFunctions();
+        return loaded;
+    }
+
+    static Functions loadFunctions()
+    {
+        Functions loaded;
+        const char *setting = getenv("LEARNOPENGL_PROGRAM_CACHE");
+        if (setting && strcmp(setting, "0") == 0)
+            return loaded;
+        GLint major = 0, minor = 0, formats = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major * 10 + minor < 41 && !GLExtensions::has("GL_ARB_get_program_binary"))
+            return loaded;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        loaded.getProgramBinary = (GetProgramBinaryFunction)glfwGetProcAddress("glGetProgramBinary");
+        loaded.programBinary = (ProgramBinaryFunction)glfwGetProcAddress("glProgramBinary");
+        loaded.programParameteri = (ProgramParameteriFunction)glfwGetProcAddress("glProgramParameteri");
+        loaded.available = formats > 0 && loaded.getProgramBinary && loaded.programBinary && loaded.programParameteri;
+        return loaded;
+    }
+
+    static std::string cachePath(const std::string &vertexPath, const std::string &key)
+    {
+        return cacheDirectory(vertexPath) + "/" + key + ".bin";
+    }
+
+    static std::string cacheDirectory(const std::string &vertexPath)
+    {
+        size_t slash = vertexPath.find_last_of('/');
+        return (slash == std::string::npos ? std::string(".") : vertexPath.substr(0, slash)) + "/.programcache";
+    }
+
+    static double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+#endif
@@ -0,0 +1,185 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/shader_m.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Collects a frame's draws and executes them sorted by a packed 64-bit key instead of in submission order:
+//
+//   opaque passes:  pass:2 | program:10 | material:20 | VAO:16 | depth:16 (front to back)
+//   transparent:    pass:2 | depth:16 (back to front) | program:10 | material:20 | VAO:16
+//
+// so draws sharing a program, textures and vertex array run back to back. Binds go through GLState, which
+// skips whatever is already current.
+class RenderQueue
+{
+public:
+    enum Pass {
+        OPAQUE_PASS = 0,
+        ALPHA_TESTED_PASS = 1,  // after the opaque draws, so their depth rejects the discarding fragments early
+        SKY_PASS = 2,           // depth test GL_LEQUAL, for geometry at the far plane
+        TRANSPARENT_PASS = 3
+    };
+
+    static const int MAX_TEXTURES = 8;
+
+    struct Draw {
+        Pass pass = OPAQUE_PASS;
+        Shader *shader = nullptr;  // required
+        GLuint vao = 0;
+        float depth = 0.0f;  // distance from the camera
+        // bound to units 0..textureCount-1
+        GLenum textureTargets[MAX_TEXTURES];
+        GLuint textures[MAX_TEXTURES];
+        int textureCount = 0;
+        // sets the draw's own uniforms and issues the draw call, with the program, VAO and textures bound
+        std::function<void(Shader&)> issue;
+
+        void addTexture(GLenum target, GLuint id)
+        {
+            if (textureCount < MAX_TEXTURES)
+            {
+                textureTargets[textureCount] = target;
+                textures[textureCount++] = id;
+            }
+        }
+    };
+
+    // state changes a frame's draws need, in submission order and as executed after sorting
+    struct Changes {
+        unsigned int programs = 0;
+        unsigned int textures = 0;
+        unsigned int vaos = 0;
+    };
+
+    struct FrameStats {
+        unsigned int draws = 0;
+        Changes submitted;
+        Changes sorted;
+    };
+
+    // starts a frame; depth is quantized over [0, farPlane]
+    void begin(float farPlane)
+    {
+        draws.clear();
+        this->farPlane = farPlane;
+    }
+
+    void submit(Draw &&draw)
+    {
+        draws.push_back({ key(draw), std::move(draw) });
+    }
+
+    // sorts and runs the frame's draws; the last draw's state stays bound
+    FrameStats execute()
+    {
+        FrameStats stats;
+        stats.draws = (unsigned int)draws.size();
+        stats.submitted = changes();
+        std::stable_sort(draws.begin(), draws.end(),
+                         [](const Entry &a, const Entry &b) { return a.key < b.key; });
+
+        GLState &state = GLState::instance();
+        for (Entry &entry : draws)
+        {
+            Draw &draw = entry.draw;
+            state.setDepthFunc(draw.pass == SKY_PASS ? GL_LEQUAL : GL_LESS);
+            draw.shader->finish();
+            if (state.useProgram(draw.shader->ID))
+                stats.sorted.programs++;
+            if (state.bindVertexArray(draw.vao))
+                stats.sorted.vaos++;
+            for (int unit = 0; unit < draw.textureCount; unit++)
+            {
+                if (state.bindTexture(unit, draw.textureTargets[unit], draw.textures[unit]))
+                    stats.sorted.textures++;
+            }
+            if (draw.issue)
+                draw.issue(*draw.shader);
+        }
+        draws.clear();
+        return stats;
+    }
+
+private:
+    static const GLuint UNKNOWN = ~0u;
+
+    struct Entry {
+        uint64_t key;
+        Draw draw;
+    };
+
+    // what changes() assumes bound
+    struct Bound {
+        GLuint program = UNKNOWN;
+        GLuint vao = UNKNOWN;
+        GLenum targets[MAX_TEXTURES];
+        GLuint textures[MAX_TEXTURES];
+
+        Bound()
+        {
+            // a local copy, std::fill's reference parameter would need a definition of the static member
+            GLuint unknown = UNKNOWN;
+            std::fill(targets, targets + MAX_TEXTURES, unknown);
+            std::fill(textures, textures + MAX_TEXTURES, unknown);
+        }
+    };
+
+    std::vector<Entry> draws;
+    float farPlane = 100.0f;
+
+    uint64_t key(const Draw &draw) const
+    {
+        // the textures stand in for the material, FNV-1a folded to 20 bits
+        uint32_t material = 2166136261u;
+        for (int unit = 0; unit < draw.textureCount; unit++)
+            material = (material ^ draw.textures[unit]) * 16777619u;
+        material = (material ^ (material >> 20)) & 0xFFFFF;
+        float normalized = std::min(std::max(draw.depth / farPlane, 0.0f), 1.0f);
+        uint64_t depth = (uint64_t)(normalized * 65535.0f);
+        uint64_t program = draw.shader->ID & 0x3FF;
+        uint64_t key = (uint64_t)draw.pass << 62;
+        if (draw.pass == TRANSPARENT_PASS)
+            return key | (0xFFFF - depth) << 46 | program << 36 | (uint64_t)material << 16 | (draw.vao & 0xFFFF);
+        return key | program << 52 | (uint64_t)material << 32 | (uint64_t)(draw.vao & 0xFFFF) << 16 | depth;
+    }
+
+    // the state changes of running the draws in their current order with the same redundancy filtering
+    Changes changes() const
+    {
+        Changes counted;
+        Bound bound;
+        for (const Entry &entry : draws)
+        {
+            const Draw &draw = entry.draw;
+            if (bound.program != draw.shader->ID)
+            {
+                bound.program = draw.shader->ID;
+                counted.programs++;
+            }
+            if (bound.vao != draw.vao)
+            {
+                bound.vao = draw.vao;
+                counted.vaos++;
+            }
+            for (int unit = 0; unit < draw.textureCount; unit++)
+            {
+                if (bound.textures[unit] != draw.textures[unit] || bound.targets[unit] != draw.textureTargets[unit])
+                {
+                    bound.targets[unit] = draw.textureTargets[unit];
+                    bound.textures[unit] = draw.textures[unit];
+                    counted.textures++;
+                }
+            }
+        }
+        return counted;
+    }
+};
+#endif
@@ -9,13 +9,20 @@
 #include <sstream>
 #include <iostream>
 #include <common.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/program_cache.h>
+#include <learnopengl/uniform_cache.h>
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly. A deferred shader only submits the compile and link work
+    // and is finished on first use (or by finish()), so the driver can compile several programs at once.
+    // defines ("#define NAME value" lines) are inserted after the #version line of every source.
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, bool deferred = false,
+           const std::string &defines = "")
+        : defines(defines)
     {
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
@@ -64,114 +71,265 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        vertexCode = withDefines(vertexCode);
+        fragmentCode = withDefines(fragmentCode);
+        if (!geometryCode.empty())
+            geometryCode = withDefines(geometryCode);
+        // 2. reuse the program binary from an earlier run, or compile the shaders
+        cacheKey = ProgramCache::key(vertexCode, fragmentCode, geometryCode, defines);
+        cacheVertexPath = vertexPathString;
+        ID = ProgramCache::load(cacheVertexPath, cacheKey);
+        if (ID == 0)
+            ID = compile(vertexCode, fragmentCode, geometryCode);
+        if (!deferred)
+            finish();
+    }
+    // true once finish() will not wait for the compiler; without KHR_parallel_shader_compile there is no way
+    // to ask, so a pending shader always claims to be ready
+    // ------------------------------------------------------------------------
+    bool ready() const
+    {
+        if (finished || !GLExtensions::hasParallelShaderCompile())
+            return true;
+        GLint completed = 0;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed != 0;
+    }
+    bool pending() const
+    {
+        return !finished;
+    }
+    // reports compile and link errors, stores the program binary and introspects the uniforms
+    // ------------------------------------------------------------------------
+    void finish() const
+    {
+        if (finished)
+            return;
+        finished = true;
+        complete(ID, cacheKey);
+        uniforms.introspect(ID);
+    }
+    // replaces the program with one built from new sources if that links, otherwise reports the errors and
+    // keeps the current program. Handles from uniform() stay valid across reloads.
+    // ------------------------------------------------------------------------
+    bool reload(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode = "")
+    {
+        finish();
+        std::string vertexSource = withDefines(vertexCode);
+        std::string fragmentSource = withDefines(fragmentCode);
+        std::string geometrySource = geometryCode.empty() ? geometryCode : withDefines(geometryCode);
+        std::string key = ProgramCache::key(vertexSource, fragmentSource, geometrySource, defines);
+        unsigned int program = ProgramCache::load(cacheVertexPath, key);
+        if (program == 0)
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            program = compile(vertexSource, fragmentSource, geometrySource);
+            if (!complete(program, key))
+            {
+                glDeleteProgram(program);
+                return false;
+            }
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        glDeleteProgram(ID);
+        ID = program;
+        cacheKey = key;
+        uniforms.introspect(ID);
+        return true;
     }
     // activate the shader
     // ------------------------------------------------------------------------
-    void use() 
+    void use() const
     { 
-        glUseProgram(ID); 
+        finish();
+        GLState::instance().useProgram(ID);
+    }
+    // utility uniform functions, by name or by a handle from uniform() for hot paths. Unchanged values and
+    // inactive uniforms issue no GL call, see UniformCache.
+    // ------------------------------------------------------------------------
+    UniformHandle uniform(const std::string &name) const
+    {
+        finish();
+        return uniforms.handle(name);
     }
-    // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
-    {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+    {
+        setInt(uniforms.handle(name), (int)value);
+    }
+    void setBool(UniformHandle handle, bool value) const
+    {
+        setInt(handle, (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
-    { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    {
+        setInt(uniforms.handle(name), value);
+    }
+    void setInt(UniformHandle handle, int value) const
+    {
+        if (uniforms.changed(handle, value))
+            glUniform1i(uniforms.location(handle), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
-    { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    {
+        setFloat(uniforms.handle(name), value);
+    }
+    void setFloat(UniformHandle handle, float value) const
+    {
+        if (uniforms.changed(handle, value))
+            glUniform1f(uniforms.location(handle), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
-    { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    {
+        setVec2(uniforms.handle(name), value);
     }
     void setVec2(const std::string &name, float x, float y) const
-    { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+    {
+        setVec2(uniforms.handle(name), glm::vec2(x, y));
+    }
+    void setVec2(UniformHandle handle, const glm::vec2 &value) const
+    {
+        if (uniforms.changed(handle, value))
+            glUniform2fv(uniforms.location(handle), 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
-    { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    {
+        setVec3(uniforms.handle(name), value);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
-    { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+    {
+        setVec3(uniforms.handle(name), glm::vec3(x, y, z));
+    }
+    void setVec3(UniformHandle handle, const glm::vec3 &value) const
+    {
+        if (uniforms.changed(handle, value))
+            glUniform3fv(uniforms.location(handle), 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
-    { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    {
+        setVec4(uniforms.handle(name), value);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
-    { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+    void setVec4(const std::string &name, float x, float y, float z, float w) const
+    {
+        setVec4(uniforms.handle(name), glm::vec4(x, y, z, w));
+    }
+    void setVec4(UniformHandle handle, const glm::vec4 &value) const
+    {
+        if (uniforms.changed(handle, value))
+            glUniform4fv(uniforms.location(handle), 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat2(uniforms.handle(name), mat);
+    }
+    void setMat2(UniformHandle handle, const glm::mat2 &mat) const
+    {
+        if (uniforms.changed(handle, mat))
+            glUniformMatrix2fv(uniforms.location(handle), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(uniforms.handle(name), mat);
+    }
+    void setMat3(UniformHandle handle, const glm::mat3 &mat) const
+    {
+        if (uniforms.changed(handle, mat))
+            glUniformMatrix3fv(uniforms.location(handle), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(uniforms.handle(name), mat);
+    }
+    void setMat4(UniformHandle handle, const glm::mat4 &mat) const
+    {
+        if (uniforms.changed(handle, mat))
+            glUniformMatrix4fv(uniforms.location(handle), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    mutable UniformCache uniforms;
+    // compile state of a deferred shader until finish()
+    mutable bool finished = false;
+    mutable unsigned int vertex = 0, fragment = 0, geometry = 0;
+    std::string cacheKey, cacheVertexPath;
+    std::string defines;
+
+    std::string withDefines(const std::string &code) const
+    {
+        if (defines.empty())
+            return code;
+        size_t version = code.find("#version");
+        if (version == std::string::npos)
+            return defines + "\n" + code;
+        size_t lineEnd = code.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return code + "\n" + defines + "\n";
+        return code.substr(0, lineEnd + 1) + defines + "\n" + code.substr(lineEnd + 1);
+    }
+
+    // starts compiling the shaders and linking them into a new program, the results are checked by complete().
+    // An empty geometryCode means there is no geometry shader.
+    // ------------------------------------------------------------------------
+    unsigned int compile(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode) const
+    {
+        const char* vShaderCode = vertexCode.c_str();
+        const char * fShaderCode = fragmentCode.c_str();
+        // vertex shader
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        // fragment Shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        // if geometry shader is given, compile geometry shader
+        if(!geometryCode.empty())
+        {
+            const char * gShaderCode = geometryCode.c_str();
+            geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(geometry, 1, &gShaderCode, NULL);
+            glCompileShader(geometry);
+        }
+        // shader Program
+        unsigned int program = ProgramCache::create();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        if(geometry != 0)
+            glAttachShader(program, geometry);
+        glLinkProgram(program);
+        return program;
+    }
+    // reports the errors of a program from compile() and stores it once linked, true if it linked. Programs
+    // restored from the cache have no shaders to check.
+    // ------------------------------------------------------------------------
+    bool complete(unsigned int program, const std::string &key) const
+    {
+        if (vertex == 0)
+            return true;
+        bool compiled = checkCompileErrors(vertex, "VERTEX");
+        compiled = checkCompileErrors(fragment, "FRAGMENT") && compiled;
+        if(geometry != 0)
+            compiled = checkCompileErrors(geometry, "GEOMETRY") && compiled;
+        bool linked = checkCompileErrors(program, "PROGRAM");
+        // delete the shaders as they're linked into our program now and no longer necessery
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        if(geometry != 0)
+            glDeleteShader(geometry);
+        vertex = fragment = geometry = 0;
+        if (linked)
+            ProgramCache::store(cacheVertexPath, key, program);
+        return compiled && linked;
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type) const
     {
         GLint success;
         GLchar infoLog[1024];
@@ -193,6 +351,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
 #endif
@@ -0,0 +1,241 @@
+#ifndef SHADER_MANAGER_H
+#define SHADER_MANAGER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/shader.h>
+
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Owns the programs of a scene. load() submits a program's compile and link work and returns at once, the
+// program is finished the first time it is used. With KHR_parallel_shader_compile the driver compiles all
+// submitted programs on its own threads in the meantime, otherwise the work still overlaps whatever the
+// application does before the first use, up to the driver.
+//
+// watch() starts hot reloading: a background thread waits on inotify for writes to the shader sources and
+// reads the changed files, update() then rebuilds every program built from them on the GL thread. A program is
+// swapped only if the new sources link, otherwise the errors are logged and the old program keeps running.
+class ShaderManager
+{
+public:
+    ShaderManager()
+    {
+        // let the driver choose how many compiler threads to use
+        typedef void (APIENTRY *MaxShaderCompilerThreadsFunction)(GLuint);
+        if (!GLExtensions::hasParallelShaderCompile())
+            return;
+        MaxShaderCompilerThreadsFunction maxThreads =
+            (MaxShaderCompilerThreadsFunction)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+        if (!maxThreads)
+            maxThreads = (MaxShaderCompilerThreadsFunction)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+        if (maxThreads)
+            maxThreads(0xFFFFFFFFu);
+    }
+
+    ShaderManager(const ShaderManager &) = delete;
+    ShaderManager &operator=(const ShaderManager &) = delete;
+
+    ~ShaderManager()
+    {
+        stopping = true;
+        if (watcher.joinable())
+            watcher.join();
+        if (inotifyFd >= 0)
+            close(inotifyFd);
+    }
+
+    // the reference stays valid for the manager's lifetime; like Shader, the programs live as long as the context.
+    // defines selects a variant of the sources (see Shader), programs loaded after watch() are watched too.
+    Shader &load(const std::string &vertexPath, const std::string &fragmentPath, const std::string &defines = "")
+    {
+        Shader *shader = new Shader(vertexPath.c_str(), fragmentPath.c_str(), nullptr, true, defines);
+        programs.push_back({ std::unique_ptr<Shader>(shader), vertexPath, fragmentPath });
+        if (inotifyFd >= 0)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            watchPath(vertexPath);
+            watchPath(fragmentPath);
+        }
+        return *programs.back().shader;
+    }
+
+    // finishes the programs the driver has already completed, never waits for the compiler
+    void poll()
+    {
+        for (const Program &program : programs)
+        {
+            if (program.shader->pending() && GLExtensions::hasParallelShaderCompile() && program.shader->ready())
+                program.shader->finish();
+        }
+    }
+
+    size_t pendingCount() const
+    {
+        size_t count = 0;
+        for (const Program &program : programs)
+            count += program.shader->pending() ? 1 : 0;
+        return count;
+    }
+
+    size_t size() const
+    {
+        return programs.size();
+    }
+
+    // starts watching the sources of every program, including the ones loaded later
+    bool watch()
+    {
+        if (watcher.joinable())
+            return true;
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyFd < 0)
+        {
+            std::cout << "WARNING::SHADER_MANAGER::INOTIFY_UNAVAILABLE shaders will not be reloaded" << std::endl;
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const Program &program : programs)
+            {
+                watchPath(program.vertexPath);
+                watchPath(program.fragmentPath);
+            }
+        }
+        watcher = std::thread([this] { watchLoop(); });
+        return true;
+    }
+
+    // rebuilds the programs whose sources changed since the last call, on the GL thread. Every variant built
+    // from a changed file is rebuilt. Returns how many programs were replaced.
+    unsigned int update()
+    {
+        std::map<std::string, std::string> sources; // only the newest contents of each file matter
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto &change : changes)
+                sources[change.first] = std::move(change.second);
+            changes.clear();
+        }
+        if (sources.empty())
+            return 0;
+        auto source = [&sources](const std::string &path) {
+            auto it = sources.find(path);
+            return it != sources.end() ? it->second : readFileContents(path);
+        };
+        unsigned int replaced = 0;
+        for (const Program &program : programs)
+        {
+            if (!sources.count(program.vertexPath) && !sources.count(program.fragmentPath))
+                continue;
+            auto start = std::chrono::steady_clock::now();
+            if (program.shader->reload(source(program.vertexPath), source(program.fragmentPath)))
+            {
+                replaced++;
+                std::cout << "Shader reloaded: " << program.vertexPath << " + " << program.fragmentPath << " in "
+                          << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                          << " ms" << std::endl;
+            }
+            else
+            {
+                std::cout << "ERROR::SHADER_MANAGER::RELOAD_FAILED " << program.vertexPath << " + " << program.fragmentPath
+                          << ", keeping the previous program" << std::endl;
+            }
+        }
+        return replaced;
+    }
+
+private:
+    struct Program {
+        std::unique_ptr<Shader> shader;
+        std::string vertexPath;
+        std::string fragmentPath;
+    };
+
+    std::vector<Program> programs;
+
+    int inotifyFd = -1;
+    std::thread watcher;
+    std::atomic<bool> stopping{ false };
+    // guarded by mutex: the watched directories by descriptor, the watched files, and the files read by the
+    // watcher that update() has not applied yet
+    std::mutex mutex;
+    std::map<int, std::string> directories;
+    std::set<std::string> watchedPaths;
+    std::vector<std::pair<std::string, std::string>> changes;
+
+    static std::string directoryOf(const std::string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+    }
+
+    // with mutex held
+    void watchPath(const std::string &path)
+    {
+        if (!watchedPaths.insert(path).second)
+            return;
+        std::string directory = directoryOf(path);
+        // editors either rewrite the file in place or write a new one and rename it over the old
+        int descriptor = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (descriptor >= 0)
+            directories[descriptor] = directory;
+    }
+
+    void watchLoop()
+    {
+        alignas(struct inotify_event) char buffer[4096];
+        while (!stopping)
+        {
+            // wakes up regularly to notice stopping
+            pollfd descriptor = { inotifyFd, POLLIN, 0 };
+            if (::poll(&descriptor, 1, 100) <= 0)
+                continue;
+            ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+            if (length <= 0)
+                continue;
+
+            std::set<std::string> changed;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (char *cursor = buffer; cursor < buffer + length; )
+                {
+                    const struct inotify_event *event = (const struct inotify_event*)cursor;
+                    auto directory = directories.find(event->wd);
+                    if (event->len > 0 && directory != directories.end())
+                    {
+                        std::string path = directory->second + "/" + event->name;
+                        if (watchedPaths.count(path))
+                            changed.insert(path);
+                    }
+                    cursor += sizeof(struct inotify_event) + event->len;
+                }
+            }
+
+            for (const std::string &path : changed)
+            {
+                std::string code = readFileContents(path);
+                // an editor may have replaced the file non-atomically, the next write triggers another reload
+                if (code.empty())
+                    continue;
+                std::lock_guard<std::mutex> lock(mutex);
+                changes.push_back({ path, std::move(code) });
+            }
+        }
+    }
+};
+#endif
@@ -0,0 +1,146 @@
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader_manager.h>
+#include <learnopengl/uniform_blocks.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+// The lighting terms one draw needs. Every combination is a separate program variant of the lighting shader,
+// built from the same sources with #defines, so a variant only evaluates the lights and material maps it uses.
+struct LightingFeatures {
+    static const int MAX_POINT_LIGHTS = LightsBlock::POINT_LIGHTS;
+
+    int pointLights = 0;                          // point lights reaching the object
+    int pointLightIndex[MAX_POINT_LIGHTS] = {};   // their slots in the Lights block
+    bool spotLight = false;
+    bool specularMap = false;
+    bool normalMap = false;
+    bool instanced = false;                       // model matrices from InstanceBuffer instead of the model uniform
+    bool multiDraw = false;                       // model matrix and vertex decoding from MeshArena's draw data
+
+    // the lights of the Lights block that can reach a bounding sphere in world space; the material maps are
+    // left to the mesh being drawn
+    static LightingFeatures select(const LightsBlock &lights, const glm::vec3 &center, float radius)
+    {
+        LightingFeatures features;
+        for (int i = 0; i < MAX_POINT_LIGHTS; i++)
+        {
+            if (glm::length(lights.pointLights[i].position - center) <= pointLightRange(lights.pointLights[i]) + radius)
+                features.pointLightIndex[features.pointLights++] = i;
+        }
+        features.spotLight = spotLightReaches(lights.spotLight, center, radius);
+        return features;
+    }
+
+    // distance at which the light falls below 1/256 of its brightest color: the attenuation
+    // 1 / (constant + linear * d + quadratic * d^2) solved for d
+    static float pointLightRange(const PointLightBlock &light)
+    {
+        glm::vec3 color = light.ambient + light.diffuse + light.specular;
+        float brightest = std::max(color.r, std::max(color.g, color.b));
+        float c = light.constant - 256.0f * brightest;
+        if (c >= 0.0f)
+            return 0.0f;
+        if (light.quadratic <= 0.0f)
+            return light.linear > 0.0f ? -c / light.linear : INFINITY;
+        return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+    }
+
+    // whether the sphere touches the outer cone, outside of it the spot light contributes nothing. The shader
+    // does not attenuate the spot light by distance, so the cone is unbounded.
+    static bool spotLightReaches(const SpotLightBlock &light, const glm::vec3 &center, float radius)
+    {
+        glm::vec3 toCenter = center - light.position;
+        float alongAxis = glm::dot(toCenter, glm::normalize(light.direction));
+        float fromAxis = std::sqrt(std::max(glm::dot(toCenter, toCenter) - alongAxis * alongAxis, 0.0f));
+        float cosine = light.outerCutOff;
+        float sine = std::sqrt(std::max(1.0f - cosine * cosine, 0.0f));
+        // signed distance from the center to the cone's surface, and whether the sphere lies behind the apex
+        return cosine * fromAxis - sine * alongAxis <= radius && alongAxis >= -radius;
+    }
+
+    // identifies the variant: the point light count, not which lights, selects the program
+    unsigned int key() const
+    {
+        return (unsigned int)pointLights | (spotLight ? 1u << 2 : 0) | (specularMap ? 1u << 3 : 0) | (normalMap ? 1u << 4 : 0)
+               | (instanced ? 1u << 5 : 0) | (multiDraw ? 1u << 6 : 0);
+    }
+
+    std::string defines() const
+    {
+        std::ostringstream out;
+        out << "#define NUM_POINT_LIGHTS " << pointLights << "\n"
+            << "#define SPOT_LIGHT " << (spotLight ? 1 : 0) << "\n"
+            << "#define SPECULAR_MAP " << (specularMap ? 1 : 0) << "\n"
+            << "#define NORMAL_MAP " << (normalMap ? 1 : 0) << "\n"
+            << "#define INSTANCED " << (instanced ? 1 : 0) << "\n"
+            << "#define MULTI_DRAW " << (multiDraw ? 1 : 0);
+        return out.str();
+    }
+
+    std::string describe() const
+    {
+        std::ostringstream out;
+        out << pointLights << " point lights" << (spotLight ? ", spot light" : "") << (specularMap ? ", specular map" : "")
+            << (normalMap ? ", normal map" : "") << (instanced ? ", instanced" : "")
+            << (multiDraw ? ", multi-draw" : "");
+        return out.str();
+    }
+};
+
+// Variants of one shader, compiled through the ShaderManager the first time a draw needs them and kept for the
+// manager's lifetime. Each variant is an ordinary program: binary cache, uniform cache and hot reload apply.
+class ShaderPermutations
+{
+public:
+    // a variant's program with the per-draw uniforms resolved
+    struct Variant {
+        Shader *shader;
+        UniformHandle model;
+        UniformHandle shininess;
+        UniformHandle pointLightIndex[LightingFeatures::MAX_POINT_LIGHTS];
+    };
+
+    ShaderPermutations(ShaderManager &manager, const std::string &vertexPath, const std::string &fragmentPath)
+        : manager(manager), vertexPath(vertexPath), fragmentPath(fragmentPath)
+    {
+    }
+
+    ShaderPermutations(const ShaderPermutations &) = delete;
+    ShaderPermutations &operator=(const ShaderPermutations &) = delete;
+
+    Variant &get(const LightingFeatures &features)
+    {
+        auto it = variants.find(features.key());
+        if (it != variants.end())
+            return it->second;
+        Variant variant;
+        variant.shader = &manager.load(vertexPath, fragmentPath, features.defines());
+        variant.model = variant.shader->uniform("model");
+        variant.shininess = variant.shader->uniform("material.shininess");
+        for (int i = 0; i < LightingFeatures::MAX_POINT_LIGHTS; i++)
+            variant.pointLightIndex[i] = variant.shader->uniform("pointLightIndex[" + std::to_string(i) + "]");
+        std::cout << "Shader variant " << variants.size() + 1 << " of " << fragmentPath << ": " << features.describe() << std::endl;
+        return variants.emplace(features.key(), variant).first->second;
+    }
+
+    size_t size() const
+    {
+        return variants.size();
+    }
+
+private:
+    ShaderManager &manager;
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::map<unsigned int, Variant> variants;
+};
+#endif
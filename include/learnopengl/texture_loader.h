@@ -0,0 +1,461 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <learnopengl/baked_texture.h>
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/pixel_upload_ring.h>
+#include <learnopengl/thread_pool.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// Decodes images with stb_image on worker threads while the GL thread keeps rendering. Every request returns
+// a texture name right away with a 1x1 placeholder uploaded into it; pump() later re-specifies that same
+// texture with the real pixels, so whoever holds the name picks the real image up without further changes.
+//
+// When texture_baker has produced an up-to-date "<image>.rgtex" next to the image, its pre-filtered mip chain
+// is read instead of decoding the image, and no mipmaps are generated at load time. Block compressed containers
+// (BC1/BC3/BC5) are uploaded as they are; when the context lacks S3TC, or a compressed chain can't be flipped
+// as requested, the source image is decoded instead.
+//
+// stb_image's vertical flip flag is process-global and not safe to toggle from several threads, so it is
+// left off and flipping is done here per request instead.
+class TextureLoader
+{
+public:
+    // shared loader used by TextureFromFile, loadTexture and loadCubemap
+    static TextureLoader& instance()
+    {
+        static TextureLoader loader;
+        return loader;
+    }
+
+    // must be constructed on the GL thread, the supported compressed formats are queried here
+    explicit TextureLoader(unsigned int threadCount = 0, size_t queueCapacity = 8)
+        : ready(queueCapacity), decoders(threadCount), s3tc(GLExtensions::hasS3TC()) {}
+
+    ~TextureLoader()
+    {
+        // unblocks decoders still waiting for room so the pool can join them
+        ready.close();
+    }
+
+    // clampIfAlpha selects GL_CLAMP_TO_EDGE wrapping for images that turn out to have an alpha channel
+    unsigned int load2D(const std::string &path, bool flipVertically = false, bool clampIfAlpha = false)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        uploadPlaceholder(textureID, GL_TEXTURE_2D, GL_TEXTURE_2D);
+
+        Request request;
+        request.textureID = textureID;
+        request.target = GL_TEXTURE_2D;
+        request.path = path;
+        request.flipVertically = flipVertically;
+        request.clampIfAlpha = clampIfAlpha;
+        enqueue(request);
+        inFlight.insert(textureID);
+        return textureID;
+    }
+
+    // faces in GL order: +X, -X, +Y, -Y, +Z, -Z. The faces are uploaded together once all six are decoded.
+    unsigned int loadCubemap(const std::vector<std::string> &faces, bool flipVertically = false)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        for (unsigned int i = 0; i < 6; i++)
+            uploadPlaceholder(textureID, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i);
+
+        pendingCubemaps[textureID].faces.resize(faces.size());
+        for (unsigned int i = 0; i < faces.size(); i++)
+        {
+            Request request;
+            request.textureID = textureID;
+            request.target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
+            request.path = faces[i];
+            request.flipVertically = flipVertically;
+            request.clampIfAlpha = false;
+            enqueue(request);
+        }
+        inFlight.insert(textureID);
+        return textureID;
+    }
+
+    // a 1x1 texture of one color, uploaded right away; stands in for the diffuse map of untextured materials
+    unsigned int loadColor(const glm::vec3 &color)
+    {
+        unsigned char rgba[4] = { 255, 255, 255, 255 };
+        for (int i = 0; i < 3; i++)
+            rgba[i] = (unsigned char)std::lround(glm::clamp(color[i], 0.0f, 1.0f) * 255.0f);
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        GLState::instance().bindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        residentBytes[textureID] = sizeof(rgba);
+        return textureID;
+    }
+
+    // deletes a texture created by load2D, loadCubemap or loadColor. One still being decoded is deleted when its image
+    // arrives, so its name can't be handed out again while an upload into it is outstanding.
+    void release(unsigned int textureID)
+    {
+        if (inFlight.count(textureID))
+        {
+            released.insert(textureID);
+            return;
+        }
+        GLState::instance().deleteTexture(textureID);
+        residentBytes.erase(textureID);
+    }
+
+    // bytes uploaded into the texture, mip levels included; 0 while only the placeholder is resident
+    size_t textureBytes(unsigned int textureID) const
+    {
+        auto found = residentBytes.find(textureID);
+        return found == residentBytes.end() ? 0 : found->second;
+    }
+
+    // uploads up to maxUploads decoded images, call once per frame on the GL thread
+    unsigned int pump(unsigned int maxUploads = ~0u)
+    {
+        unsigned int uploaded = 0;
+        DecodedImage image;
+        while (uploaded < maxUploads && ready.tryPop(image))
+        {
+            if (receive(image))
+                uploaded++;
+        }
+        return uploaded;
+    }
+
+    // blocks the GL thread until every requested image has been uploaded
+    void finish()
+    {
+        DecodedImage image;
+        while (pending > 0)
+        {
+            if (ready.popFor(image, std::chrono::milliseconds(100)))
+                receive(image);
+        }
+    }
+
+    // images requested but not uploaded yet
+    unsigned int pendingCount() const
+    {
+        return pending;
+    }
+
+    // every upload goes through this ring, it also keeps the per-frame upload counters
+    PixelUploadRing& uploadRing()
+    {
+        return uploads;
+    }
+
+private:
+    struct StbiDeleter {
+        void operator()(unsigned char *pixels) const
+        {
+            stbi_image_free(pixels);
+        }
+    };
+
+    struct Request {
+        unsigned int textureID;
+        GLenum target;
+        std::string path;
+        bool flipVertically;
+        bool clampIfAlpha;
+    };
+
+    struct DecodedImage {
+        Request request;
+        int width = 0;
+        int height = 0;
+        int components = 0;
+        std::unique_ptr<unsigned char, StbiDeleter> pixels;
+        // set instead of pixels when the image came from its baked container
+        bool baked = false;
+        BakedTexture levels;
+        // why an existing container was passed over for the source image, logged on upload
+        const char *fallback = nullptr;
+
+        bool valid() const
+        {
+            return baked || pixels;
+        }
+    };
+
+    struct PendingCubemap {
+        std::vector<DecodedImage> faces;
+        unsigned int received = 0;
+    };
+
+    // declared before the pool so the pool's workers are joined while the queue is still alive
+    BoundedQueue<DecodedImage> ready;
+    ThreadPool decoders;
+    std::map<unsigned int, PendingCubemap> pendingCubemaps;
+    unsigned int pending = 0;
+    // textures with images still to come, those of them released meanwhile, and what the uploaded ones occupy
+    std::set<unsigned int> inFlight;
+    std::set<unsigned int> released;
+    std::map<unsigned int, size_t> residentBytes;
+    PixelUploadRing uploads;
+    bool s3tc;
+
+    void enqueue(const Request &request)
+    {
+        pending++;
+        BoundedQueue<DecodedImage> &queue = ready;
+        bool s3tcSupported = s3tc;
+        decoders.submit([request, &queue, s3tcSupported] {
+            DecodedImage image;
+            image.request = request;
+            if (BakedTexture::load(request.path, image.levels))
+            {
+                BakedFormat format = image.levels.format;
+                if (BakedTexture::isCompressed(format) && format != BAKED_BC5 && !s3tcSupported)
+                    image.fallback = "S3TC not supported";
+                else if (request.flipVertically && !image.levels.flipVertically())
+                    image.fallback = "compressed mip chain can't be flipped";
+                else
+                {
+                    image.baked = true;
+                    image.width = (int)image.levels.width;
+                    image.height = (int)image.levels.height;
+                    image.components = (int)BakedTexture::componentsOf(format);
+                }
+            }
+            if (!image.baked)
+            {
+                image.levels = BakedTexture();
+                decodeSource(image);
+            }
+            queue.push(std::move(image));
+        });
+    }
+
+    static void decodeSource(DecodedImage &image)
+    {
+        const Request &request = image.request;
+        image.pixels.reset(stbi_load(request.path.c_str(), &image.width, &image.height, &image.components, 0));
+        if (image.pixels && request.flipVertically)
+            flipRows(image.pixels.get(), image.width, image.height, image.components);
+    }
+
+    static bool isCompressed(const DecodedImage &image)
+    {
+        return image.baked && BakedTexture::isCompressed(image.levels.format);
+    }
+
+    static GLenum compressedFormatFor(BakedFormat format)
+    {
+        switch (format)
+        {
+            case BAKED_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case BAKED_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            default: return GL_COMPRESSED_RG_RGTC2;
+        }
+    }
+
+    static void logCompressed(const std::string &name, BakedFormat format, uint64_t compressed, uint64_t uncompressed)
+    {
+        std::cout << "Texture " << name << ": " << BakedTexture::nameOf(format) << ", " << compressed / 1024 << " KiB instead of "
+                  << uncompressed / 1024 << " KiB (saved " << (uncompressed - compressed) / 1024 << " KiB)" << std::endl;
+    }
+
+    static void flipRows(unsigned char *pixels, int width, int height, int components)
+    {
+        size_t rowSize = (size_t)width * components;
+        std::vector<unsigned char> row(rowSize);
+        for (int top = 0, bottom = height - 1; top < bottom; top++, bottom--)
+        {
+            unsigned char *a = pixels + top * rowSize;
+            unsigned char *b = pixels + bottom * rowSize;
+            memcpy(row.data(), a, rowSize);
+            memcpy(a, b, rowSize);
+            memcpy(b, row.data(), rowSize);
+        }
+    }
+
+    static size_t imageSize(const DecodedImage &image)
+    {
+        return (size_t)image.width * image.height * image.components;
+    }
+
+    static GLenum formatFor(int components)
+    {
+        if (components == 1)
+            return GL_RED;
+        else if (components == 2)
+            return GL_RG;
+        else if (components == 3)
+            return GL_RGB;
+        return GL_RGBA;
+    }
+
+    // neutral grey, sampled until the real image arrives
+    static void uploadPlaceholder(unsigned int textureID, GLenum bindTarget, GLenum imageTarget)
+    {
+        static const unsigned char grey[4] = { 128, 128, 128, 255 };
+        GLState::instance().bindTexture(bindTarget, textureID);
+        glTexImage2D(imageTarget, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        glTexParameteri(bindTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(bindTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    // returns true once an image actually reached the GPU (cube map faces wait for their siblings)
+    bool receive(DecodedImage &image)
+    {
+        const Request &request = image.request;
+        if (!image.valid())
+            std::cout << "Texture failed to load at path: " << request.path << std::endl;
+        else if (image.fallback)
+            std::cout << "Texture " << request.path << ": baked container not used (" << image.fallback << ")" << std::endl;
+
+        if (request.target == GL_TEXTURE_2D)
+        {
+            pending--;
+            if (!complete(request.textureID))
+                return false;
+            if (image.valid())
+                upload2D(image);
+            return true;
+        }
+
+        unsigned int textureID = request.textureID;
+        PendingCubemap &cubemap = pendingCubemaps[textureID];
+        cubemap.faces[request.target - GL_TEXTURE_CUBE_MAP_POSITIVE_X] = std::move(image);
+        if (++cubemap.received < cubemap.faces.size())
+            return false;
+        pending -= cubemap.received;
+        bool keep = complete(textureID);
+        if (keep)
+            uploadCubemap(textureID, cubemap);
+        pendingCubemaps.erase(textureID);
+        return keep;
+    }
+
+    // the last image of a texture arrived; false when the texture was released meanwhile and is now deleted
+    bool complete(unsigned int textureID)
+    {
+        inFlight.erase(textureID);
+        if (!released.erase(textureID))
+            return true;
+        GLState::instance().deleteTexture(textureID);
+        return false;
+    }
+
+    void upload2D(const DecodedImage &image)
+    {
+        GLenum format = formatFor(image.components);
+        GLint wrap = image.request.clampIfAlpha && image.components == 4 ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+
+        GLState::instance().bindTexture(GL_TEXTURE_2D, image.request.textureID);
+        if (image.baked)
+        {
+            const BakedTexture &baked = image.levels;
+            for (size_t i = 0; i < baked.levels.size(); i++)
+            {
+                const BakedTexture::Level &level = baked.levels[i];
+                if (isCompressed(image))
+                    uploads.uploadCompressed(GL_TEXTURE_2D, (GLint)i, compressedFormatFor(baked.format), level.width, level.height,
+                                             baked.levelData(i), level.size);
+                else
+                    uploads.upload(GL_TEXTURE_2D, (GLint)i, format, level.width, level.height, format, baked.levelData(i), level.size);
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)baked.levels.size() - 1);
+            if (isCompressed(image))
+                logCompressed(image.request.path, baked.format, baked.data.size(), baked.uncompressedSize());
+            residentBytes[image.request.textureID] = baked.data.size();
+        }
+        else
+        {
+            uploads.upload(GL_TEXTURE_2D, 0, format, image.width, image.height, format, image.pixels.get(), imageSize(image));
+            glGenerateMipmap(GL_TEXTURE_2D);
+            // a full mip chain adds a third to the top level
+            residentBytes[image.request.textureID] = imageSize(image) * 4 / 3;
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    void uploadCubemap(unsigned int textureID, PendingCubemap &cubemap)
+    {
+        // a cube map is only complete when all faces share one internal format; if the faces disagree
+        // (some baked compressed, some not), the compressed ones are decoded from source here instead
+        const DecodedImage &first = cubemap.faces[0];
+        bool mixed = false;
+        for (const DecodedImage &face : cubemap.faces)
+            if (isCompressed(face) != isCompressed(first) || (isCompressed(face) && face.levels.format != first.levels.format))
+                mixed = true;
+        if (mixed)
+        {
+            for (DecodedImage &face : cubemap.faces)
+            {
+                if (!isCompressed(face))
+                    continue;
+                face.baked = false;
+                face.levels = BakedTexture();
+                face.fallback = "cube map faces have different formats";
+                decodeSource(face);
+                std::cout << "Texture " << face.request.path << ": baked container not used (" << face.fallback << ")" << std::endl;
+            }
+        }
+
+        uint64_t compressed = 0, uncompressed = 0;
+        size_t bytes = 0;
+        GLState::instance().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        for (unsigned int i = 0; i < cubemap.faces.size(); i++)
+        {
+            const DecodedImage &face = cubemap.faces[i];
+            if (!face.valid())
+                continue;
+            // the cube map samples without mipmaps, only the top level of a baked face is needed
+            GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
+            if (isCompressed(face))
+            {
+                const BakedTexture::Level &top = face.levels.levels[0];
+                uploads.uploadCompressed(target, 0, compressedFormatFor(face.levels.format), face.width, face.height,
+                                         face.levels.levelData(0), top.size);
+                compressed += top.size;
+                uncompressed += imageSize(face);
+                bytes += top.size;
+                continue;
+            }
+            GLenum format = formatFor(face.components);
+            const unsigned char *pixels = face.baked ? face.levels.levelData(0) : face.pixels.get();
+            uploads.upload(target, 0, format, face.width, face.height, format, pixels, imageSize(face));
+            bytes += imageSize(face);
+        }
+        residentBytes[textureID] = bytes;
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        if (compressed > 0)
+        {
+            std::string directory = first.request.path.substr(0, first.request.path.find_last_of('/'));
+            logCompressed(directory + " (cube map)", first.levels.format, compressed, uncompressed);
+        }
+    }
+};
+#endif
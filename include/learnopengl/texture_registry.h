@@ -0,0 +1,132 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <learnopengl/texture_loader.h>
+
+#include <stdlib.h>
+
+#include <climits>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Process-wide texture cache in front of TextureLoader. Textures are keyed by their canonical path (all six
+// face paths for a cube map) plus the load options, so every image is decoded and uploaded once no matter how
+// many models or call sites ask for it. Each acquire adds a reference; the texture is deleted when the last
+// one is released. GL thread only.
+class TextureRegistry
+{
+public:
+    struct Stats {
+        unsigned int hits = 0;      // acquires answered with an existing texture
+        unsigned int misses = 0;    // acquires that had to load the image
+        unsigned int textures = 0;  // textures currently registered
+        size_t residentBytes = 0;   // what the registered textures occupy once uploaded
+    };
+
+    static TextureRegistry& instance()
+    {
+        static TextureRegistry registry(TextureLoader::instance());
+        return registry;
+    }
+
+    explicit TextureRegistry(TextureLoader &loader) : loader(loader) {}
+
+    unsigned int acquire2D(const std::string &path, bool flipVertically = false, bool clampIfAlpha = false)
+    {
+        std::string key = std::string("2d:") + (flipVertically ? 'f' : '-') + (clampIfAlpha ? 'c' : '-') + ':' + canonical(path);
+        unsigned int textureID;
+        if (!find(key, textureID))
+            textureID = add(key, loader.load2D(path, flipVertically, clampIfAlpha));
+        return textureID;
+    }
+
+    unsigned int acquireCubemap(const std::vector<std::string> &faces, bool flipVertically = false)
+    {
+        std::string key = std::string("cube:") + (flipVertically ? 'f' : '-');
+        for (const std::string &face : faces)
+            key += ':' + canonical(face);
+        unsigned int textureID;
+        if (!find(key, textureID))
+            textureID = add(key, loader.loadCubemap(faces, flipVertically));
+        return textureID;
+    }
+
+    // a shared 1x1 texture per 8-bit color, see TextureLoader::loadColor
+    unsigned int acquireColor(const glm::vec3 &color)
+    {
+        std::string key = "color:";
+        for (int i = 0; i < 3; i++)
+            key += std::to_string(std::lround(glm::clamp(color[i], 0.0f, 1.0f) * 255.0f)) + (i < 2 ? "," : "");
+        unsigned int textureID;
+        if (!find(key, textureID))
+            textureID = add(key, loader.loadColor(color));
+        return textureID;
+    }
+
+    // drops one reference, deleting the texture with the last one
+    void release(unsigned int textureID)
+    {
+        auto found = keys.find(textureID);
+        if (found == keys.end())
+            return;
+        Entry &entry = entries[found->second];
+        if (--entry.references > 0)
+            return;
+        entries.erase(found->second);
+        keys.erase(found);
+        loader.release(textureID);
+    }
+
+    Stats stats() const
+    {
+        Stats current = counters;
+        current.textures = (unsigned int)entries.size();
+        for (const auto &entry : entries)
+            current.residentBytes += loader.textureBytes(entry.second.textureID);
+        return current;
+    }
+
+private:
+    struct Entry {
+        unsigned int textureID;
+        unsigned int references;
+    };
+
+    TextureLoader &loader;
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<unsigned int, std::string> keys;
+    Stats counters;
+
+    bool find(const std::string &key, unsigned int &textureID)
+    {
+        auto found = entries.find(key);
+        if (found == entries.end())
+        {
+            counters.misses++;
+            return false;
+        }
+        counters.hits++;
+        found->second.references++;
+        textureID = found->second.textureID;
+        return true;
+    }
+
+    unsigned int add(const std::string &key, unsigned int textureID)
+    {
+        entries[key] = Entry{ textureID, 1 };
+        keys[textureID] = key;
+        return textureID;
+    }
+
+    // resolves "..", "." and symbolic links so different spellings of one file share an entry
+    static std::string canonical(const std::string &path)
+    {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved))
+            return resolved;
+        return path;
+    }
+};
+#endif
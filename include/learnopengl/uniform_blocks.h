@@ -0,0 +1,151 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// C++ mirrors of the std140 uniform blocks declared by the shaders. Every vec3 is followed by a float so the
+// tightly packed glm::vec3 lands on the same offsets as std140's 16-byte aligned vec3; keep both sides in
+// the same order when changing a block.
+
+// layout (std140) uniform Camera, updated once per frame
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPosition;
+    float padding;
+};
+
+struct PointLightBlock {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    float padding;
+};
+
+struct SpotLightBlock {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 direction;
+    float linear;
+    glm::vec3 ambient;
+    float quadratic;
+    glm::vec3 diffuse;
+    float cutOff;
+    glm::vec3 specular;
+    float outerCutOff;
+};
+
+// layout (std140) uniform Lights, updated once per frame
+struct LightsBlock {
+    static const int POINT_LIGHTS = 3;
+    PointLightBlock pointLights[POINT_LIGHTS];
+    SpotLightBlock spotLight;
+};
+
+static_assert(sizeof(CameraBlock) == 144 && offsetof(CameraBlock, viewPosition) == 128, "CameraBlock must match std140");
+static_assert(sizeof(PointLightBlock) == 64 && offsetof(PointLightBlock, specular) == 48, "PointLightBlock must match std140");
+static_assert(sizeof(SpotLightBlock) == 80 && offsetof(SpotLightBlock, outerCutOff) == 76, "SpotLightBlock must match std140");
+static_assert(sizeof(LightsBlock) == 272 && offsetof(LightsBlock, spotLight) == 192, "LightsBlock must match std140");
+
+// Binding points of the blocks shared by all programs. Programs are matched by block name right after link,
+// so a shader only has to declare the block to see the buffer bound there.
+class UniformBlocks
+{
+public:
+    enum Binding {
+        CAMERA = 0,
+        LIGHTS = 1
+    };
+
+    // binds every active block of program that is listed below, warns about size mismatches with the mirror
+    static void bindProgram(GLuint program)
+    {
+        GLint blocks = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < blocks; i++)
+        {
+            glGetActiveUniformBlockName(program, (GLuint)i, (GLsizei)name.size(), NULL, name.data());
+            const Block *block = find(name.data());
+            if (!block)
+            {
+                std::cout << "WARNING::UNIFORM_BLOCKS::UNKNOWN_BLOCK " << name.data() << " has no binding point" << std::endl;
+                continue;
+            }
+            GLint size = 0;
+            glGetActiveUniformBlockiv(program, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+            if ((size_t)size != block->size)
+                std::cout << "WARNING::UNIFORM_BLOCKS::SIZE_MISMATCH " << name.data() << " is " << size << " bytes in the shader, "
+                          << block->size << " in C++" << std::endl;
+            glUniformBlockBinding(program, (GLuint)i, block->binding);
+        }
+    }
+
+private:
+    struct Block {
+        const char *name;
+        Binding binding;
+        size_t size;
+    };
+
+    static const Block *find(const char *name)
+    {
+        static const Block table[] = {
+            { "Camera", CAMERA, sizeof(CameraBlock) },
+            { "Lights", LIGHTS, sizeof(LightsBlock) },
+        };
+        for (const Block &block : table)
+        {
+            if (strcmp(block.name, name) == 0)
+                return &block;
+        }
+        return nullptr;
+    }
+};
+
+// GL buffer holding one block, attached to its binding point for its whole lifetime
+template <typename T>
+class UniformBuffer
+{
+public:
+    explicit UniformBuffer(UniformBlocks::Binding binding)
+    {
+        glGenBuffers(1, &ubo);
+        GLState::instance().bindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+        GLState::instance().bindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+    }
+
+    ~UniformBuffer()
+    {
+        GLState::instance().deleteBuffer(ubo);
+    }
+
+    UniformBuffer(const UniformBuffer &) = delete;
+    UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+    // replaces the whole block, the previous contents are orphaned so a draw still reading them does not stall
+    void update(const T &data)
+    {
+        GLState::instance().bindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+    }
+
+private:
+    GLuint ubo;
+};
+#endif
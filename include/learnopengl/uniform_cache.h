@@ -0,0 +1,162 @@
+#ifndef UNIFORM_CACHE_H
+#define UNIFORM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/uniform_blocks.h>
+
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// pre-resolved uniform of one program, obtained from Shader::uniform(name). Invalid handles (inactive or
+// misspelled uniforms) are accepted by the setters and ignored, like location -1 is by glUniform*.
+struct UniformHandle {
+    int slot = -1;
+    bool valid() const { return slot >= 0; }
+};
+
+// Active uniforms of a linked program in a hashed name table, plus the last value uploaded to each so that
+// setting an unchanged value issues no GL call. The shadow values assume the program's uniforms are only
+// written through its Shader; call reset() after anything else touched them (or the program was relinked).
+class UniformCache
+{
+public:
+    struct FrameStats {
+        unsigned int issued = 0;   // glUniform* calls made
+        unsigned int skipped = 0;  // set calls that left the value unchanged or named an inactive uniform
+    };
+
+    // queries the active uniforms of a linked program, a program that failed to link has none. Array uniforms
+    // are registered per element ("weights[2]") and under their bare name, which addresses element 0. Uniform
+    // blocks are attached to their shared binding points (UniformBlocks). Introspecting a replacement program
+    // (a reloaded shader) keeps every name on its slot, so handles stay valid; names the new program lacks
+    // are left inactive.
+    void introspect(GLuint program)
+    {
+        for (Slot &slot : slots)
+        {
+            slot.location = -1;
+            slot.size = 0;
+        }
+        GLint linked = 0, count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+            return;
+        UniformBlocks::bindProgram(program);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size = 0;
+            GLenum type = 0;
+            GLsizei length = 0;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            // uniform block members have no location and are set through their buffer
+            GLint location = glGetUniformLocation(program, name.c_str());
+            if (location < 0)
+                continue;
+            int slot = slotFor(name, location);
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                names[base] = slot;
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    location = glGetUniformLocation(program, elementName.c_str());
+                    if (location >= 0)
+                        slotFor(elementName, location);
+                }
+            }
+        }
+    }
+
+    UniformHandle handle(const std::string &name) const
+    {
+        UniformHandle result;
+        auto it = names.find(name);
+        if (it != names.end())
+            result.slot = it->second;
+        return result;
+    }
+
+    GLint location(UniformHandle uniform) const
+    {
+        return uniform.valid() ? slots[uniform.slot].location : -1;
+    }
+
+    // true when the caller has to upload value: the uniform is active and holds something else. Records the
+    // value as uploaded and counts the call either way.
+    template <typename T>
+    bool changed(UniformHandle uniform, const T &value)
+    {
+        static_assert(sizeof(T) <= sizeof(Slot::value), "uniform value larger than a mat4");
+        if (!uniform.valid() || slots[uniform.slot].location < 0)
+        {
+            frame().skipped++;
+            return false;
+        }
+        Slot &slot = slots[uniform.slot];
+        if (slot.size == sizeof(T) && memcmp(slot.value, &value, sizeof(T)) == 0)
+        {
+            frame().skipped++;
+            return false;
+        }
+        memcpy(slot.value, &value, sizeof(T));
+        slot.size = sizeof(T);
+        frame().issued++;
+        return true;
+    }
+
+    // forgets the shadow values, the next set of every uniform is uploaded
+    void reset()
+    {
+        for (Slot &slot : slots)
+            slot.size = 0;
+    }
+
+    // counters of every program since the last endFrame(), which returns and clears them
+    static FrameStats endFrame()
+    {
+        FrameStats stats = frame();
+        frame() = FrameStats();
+        return stats;
+    }
+
+private:
+    struct Slot {
+        GLint location;
+        unsigned int size;   // bytes held in value, 0 while unknown
+        unsigned char value[64];
+    };
+
+    std::unordered_map<std::string, int> names;
+    std::vector<Slot> slots;
+
+    int slotFor(const std::string &name, GLint location)
+    {
+        auto it = names.find(name);
+        if (it != names.end())
+        {
+            slots[it->second].location = location;
+            return it->second;
+        }
+        Slot slot;
+        slot.location = location;
+        slot.size = 0;
+        slots.push_back(slot);
+        names[name] = (int)slots.size() - 1;
+        return (int)slots.size() - 1;
+    }
+
+    static FrameStats &frame()
+    {
+        static FrameStats stats;
+        return stats;
+    }
+};
+#endif
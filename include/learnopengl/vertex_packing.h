@@ -0,0 +1,108 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// 20-byte alternative to the 56-byte Vertex, decoded by the lighting vertex shader:
+//   position   4 x unorm16, xyz relative to the mesh bounds, w holds the bitangent sign (0 = -1, 65535 = +1)
+//   normal     2 x snorm16, octahedral
+//   texCoords  2 x half float, so tiling coordinates outside [0, 1] survive
+//   tangent    2 x snorm16, octahedral; the bitangent is cross(normal, tangent) * sign
+struct PackedVertex {
+    uint16_t position[4];
+    int16_t  normal[2];
+    uint16_t texCoords[2];
+    int16_t  tangent[2];
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must stay tightly packed");
+
+namespace VertexPacking {
+
+// IEEE 754 binary16, round to nearest even, overflow to infinity
+inline uint16_t toHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t magnitude = bits & 0x7fffffff;
+    if (magnitude >= 0x7f800000) // inf or nan
+        return (uint16_t)(sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0));
+    if (magnitude >= 0x477ff000) // rounds to beyond the largest half
+        return (uint16_t)(sign | 0x7c00);
+    if (magnitude < 0x38800000) // half denormal or zero
+    {
+        if (magnitude < 0x33000000)
+            return (uint16_t)sign;
+        uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+        int shift = 126 - (int)(magnitude >> 23);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = ((magnitude - 0x38000000) >> 13);
+    uint32_t rest = magnitude & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return (uint16_t)(sign | half);
+}
+
+inline int16_t toSnorm16(float value)
+{
+    return (int16_t)std::lround(std::min(1.0f, std::max(-1.0f, value)) * 32767.0f);
+}
+
+// unit vector to the octahedron unfolded onto [-1, 1]^2
+inline void octahedralEncode(glm::vec3 n, int16_t encoded[2])
+{
+    float length = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (length == 0.0f)
+    {
+        encoded[0] = encoded[1] = 0;
+        return;
+    }
+    float x = n.x / length, y = n.y / length;
+    if (n.z < 0.0f)
+    {
+        float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = toSnorm16(x);
+    encoded[1] = toSnorm16(y);
+}
+
+inline uint16_t toUnorm16(float value, float minimum, float extent)
+{
+    if (extent <= 0.0f)
+        return 0;
+    return (uint16_t)std::lround(std::min(1.0f, std::max(0.0f, (value - minimum) / extent)) * 65535.0f);
+}
+
+// packs one vertex whose position lies within [boundsMin, boundsMin + boundsExtent]
+inline PackedVertex pack(const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &texCoords,
+                         const glm::vec3 &tangent, const glm::vec3 &bitangent,
+                         const glm::vec3 &boundsMin, const glm::vec3 &boundsExtent)
+{
+    PackedVertex packed;
+    packed.position[0] = toUnorm16(position.x, boundsMin.x, boundsExtent.x);
+    packed.position[1] = toUnorm16(position.y, boundsMin.y, boundsExtent.y);
+    packed.position[2] = toUnorm16(position.z, boundsMin.z, boundsExtent.z);
+    packed.position[3] = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? 0 : 65535;
+    octahedralEncode(normal, packed.normal);
+    packed.texCoords[0] = toHalf(texCoords.x);
+    packed.texCoords[1] = toHalf(texCoords.y);
+    octahedralEncode(tangent, packed.tangent);
+    return packed;
+}
+
+}
+#endif
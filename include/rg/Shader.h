@@ -12,9 +12,11 @@
 #include <sstream>
 #include <rg/Error.h>
 #include <common.h>
+#include <learnopengl/uniform_cache.h>
 #include <glm/glm.hpp>
 class Shader {
     unsigned int m_Id;
+    mutable UniformCache m_Uniforms;
 public:
     Shader(std::string vertexShaderPath, std::string fragmentShaderPath) {
         appendShaderFolderIfNotPresent(vertexShaderPath);
@@ -65,6 +67,7 @@ public:
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
         m_Id = shaderProgram;
+        m_Uniforms.introspect(m_Id);
     }
 
     // activate the shader
@@ -73,67 +76,118 @@ public:
     {
         glUseProgram(m_Id);
     }
-    // utility uniform functions
+    // utility uniform functions, by name or by a handle from uniform() for hot paths. Unchanged values and
+    // inactive uniforms issue no GL call, see UniformCache.
+    // ------------------------------------------------------------------------
+    UniformHandle uniform(const std::string &name) const
+    {
+        return m_Uniforms.handle(name);
+    }
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), (int)value);
+        setInt(m_Uniforms.handle(name), (int)value);
+    }
+    void setBool(UniformHandle handle, bool value) const
+    {
+        setInt(handle, (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), value);
+        setInt(m_Uniforms.handle(name), value);
+    }
+    void setInt(UniformHandle handle, int value) const
+    {
+        if (m_Uniforms.changed(handle, value))
+            glUniform1i(m_Uniforms.location(handle), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(m_Id, name.c_str()), value);
+        setFloat(m_Uniforms.handle(name), value);
+    }
+    void setFloat(UniformHandle handle, float value) const
+    {
+        if (m_Uniforms.changed(handle, value))
+            glUniform1f(m_Uniforms.location(handle), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        setVec2(m_Uniforms.handle(name), value);
     }
     void setVec2(const std::string &name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(m_Id, name.c_str()), x, y);
+        setVec2(m_Uniforms.handle(name), glm::vec2(x, y));
+    }
+    void setVec2(UniformHandle handle, const glm::vec2 &value) const
+    {
+        if (m_Uniforms.changed(handle, value))
+            glUniform2fv(m_Uniforms.location(handle), 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        setVec3(m_Uniforms.handle(name), value);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(m_Id, name.c_str()), x, y, z);
+        setVec3(m_Uniforms.handle(name), glm::vec3(x, y, z));
+    }
+    void setVec3(UniformHandle handle, const glm::vec3 &value) const
+    {
+        if (m_Uniforms.changed(handle, value))
+            glUniform3fv(m_Uniforms.location(handle), 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        setVec4(m_Uniforms.handle(name), value);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w)
+    void setVec4(const std::string &name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(m_Id, name.c_str()), x, y, z, w);
+        setVec4(m_Uniforms.handle(name), glm::vec4(x, y, z, w));
+    }
+    void setVec4(UniformHandle handle, const glm::vec4 &value) const
+    {
+        if (m_Uniforms.changed(handle, value))
+            glUniform4fv(m_Uniforms.location(handle), 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat2(m_Uniforms.handle(name), mat);
+    }
+    void setMat2(UniformHandle handle, const glm::mat2 &mat) const
+    {
+        if (m_Uniforms.changed(handle, mat))
+            glUniformMatrix2fv(m_Uniforms.location(handle), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(m_Uniforms.handle(name), mat);
+    }
+    void setMat3(UniformHandle handle, const glm::mat3 &mat) const
+    {
+        if (m_Uniforms.changed(handle, mat))
+            glUniformMatrix3fv(m_Uniforms.location(handle), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(m_Uniforms.handle(name), mat);
+    }
+    void setMat4(UniformHandle handle, const glm::mat4 &mat) const
+    {
+        if (m_Uniforms.changed(handle, mat))
+            glUniformMatrix4fv(m_Uniforms.location(handle), 1, GL_FALSE, &mat[0][0]);
     }
     void deleteProgram() {
         glDeleteProgram(m_Id);
         m_Id = 0;
+        m_Uniforms = UniformCache();
     }
 
 
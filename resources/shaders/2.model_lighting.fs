@@ -1,54 +1,82 @@
 #version 330 core
+// variant selection, see LightingFeatures (shader_permutations.h). Compiled without defines the shader
+// evaluates every light and takes the specular intensity from the diffuse map.
+#ifndef NUM_POINT_LIGHTS
+#define NUM_POINT_LIGHTS 3
+#endif
+#ifndef SPOT_LIGHT
+#define SPOT_LIGHT 1
+#endif
+#ifndef SPECULAR_MAP
+#define SPECULAR_MAP 0
+#endif
+#ifndef NORMAL_MAP
+#define NORMAL_MAP 0
+#endif
+
 out vec4 FragColor;
 
+// std140 layouts mirrored by PointLightBlock and SpotLightBlock (uniform_blocks.h), each vec3 paired with a float
 struct PointLight {
     vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
-
-    float cutOff;
-    float outerCutOff;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
     float constant;
+    vec3 direction;
     float linear;
+    vec3 ambient;
     float quadratic;
-
+    vec3 diffuse;
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
 };
 
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
+    sampler2D texture_normal1;
 
     float shininess;
 };
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+#if NORMAL_MAP
+in mat3 TBN;
+#endif
+
+// size of the Lights block, NUM_POINT_LIGHTS of them are evaluated
+#define MAX_POINT_LIGHTS 3
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+layout (std140) uniform Lights {
+    PointLight pointLights[MAX_POINT_LIGHTS];
+    SpotLight spotLight;
+};
 
-uniform PointLight pointLight;
-uniform PointLight pointLight1;
-uniform PointLight pointLight2;
-uniform SpotLight spotLight;
 uniform Material material;
 
-uniform vec3 viewPosition;
+#if NUM_POINT_LIGHTS > 0 && NUM_POINT_LIGHTS < MAX_POINT_LIGHTS
+// slots in pointLights of the lights reaching this object
+uniform int pointLightIndex[NUM_POINT_LIGHTS];
+#endif
+
 // calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
@@ -60,16 +88,16 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
     return (ambient + diffuse + specular);
 }
 
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     float diff = max(dot(normal, lightDir), 0.0);
@@ -84,9 +112,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
 
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
@@ -98,11 +126,31 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 
 void main()
 {
+#if NORMAL_MAP
+    // tangent space normal, z is rebuilt so two-channel (BC5) maps work as well
+    vec2 tangentNormal = texture(material.texture_normal1, TexCoords).xy * 2.0 - 1.0;
+    vec3 normal = normalize(TBN * vec3(tangentNormal, sqrt(max(1.0 - dot(tangentNormal, tangentNormal), 0.0))));
+#else
     vec3 normal = normalize(Normal);
+#endif
     vec3 viewDir = normalize(viewPosition - FragPos);
-    vec3 result = CalcPointLight(pointLight, normal, FragPos, viewDir);
-    result += CalcPointLight(pointLight1, normal, FragPos, viewDir);
-    result += CalcPointLight(pointLight2, normal, FragPos, viewDir);
-    result += CalcSpotLight(spotLight, normal, FragPos, viewDir);
+    vec3 diffuseColor = vec3(texture(material.texture_diffuse1, TexCoords));
+#if SPECULAR_MAP
+    vec3 specularColor = texture(material.texture_specular1, TexCoords).xxx;
+#else
+    vec3 specularColor = diffuseColor.xxx;
+#endif
+
+    vec3 result = vec3(0.0);
+#if SPOT_LIGHT
+    result += CalcSpotLight(spotLight, normal, FragPos, viewDir, diffuseColor, specularColor);
+#endif
+#if NUM_POINT_LIGHTS >= MAX_POINT_LIGHTS
+    for (int i = 0; i < MAX_POINT_LIGHTS; i++)
+        result += CalcPointLight(pointLights[i], normal, FragPos, viewDir, diffuseColor, specularColor);
+#elif NUM_POINT_LIGHTS > 0
+    for (int i = 0; i < NUM_POINT_LIGHTS; i++)
+        result += CalcPointLight(pointLights[pointLightIndex[i]], normal, FragPos, viewDir, diffuseColor, specularColor);
+#endif
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
@@ -1,20 +1,84 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+// variant selection, see LightingFeatures (shader_permutations.h)
+#ifndef NORMAL_MAP
+#define NORMAL_MAP 0
+#endif
+#ifndef INSTANCED
+#define INSTANCED 0
+#endif
+#ifndef MULTI_DRAW
+#define MULTI_DRAW 0
+#endif
+
+layout (location = 0) in vec4 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+#if INSTANCED
+// per-instance model matrix, see InstanceBuffer
+layout (location = 5) in mat4 aInstanceModel;
+#endif
+#if MULTI_DRAW
+// the draw's texels in drawData: model matrix columns, positionOffset, positionScale (see MeshArena)
+layout (location = 9) in uint aDrawIndex;
+uniform samplerBuffer drawData;
+#endif
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+#if NORMAL_MAP
+// tangent space to the space of Normal
+out mat3 TBN;
+#endif
 
+#if !INSTANCED && !MULTI_DRAW
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+// packed vertices (see PackedVertex): position normalized to the mesh bounds with the bitangent sign in w,
+// octahedral normal and tangent in aNormal.xy and aTangent.xy. for plain vertices the offset is 0 and the scale 1
+uniform bool packedVertex;
+#if !MULTI_DRAW
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+#endif
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+#if INSTANCED
+    mat4 model = aInstanceModel;
+#endif
+#if MULTI_DRAW
+    int texel = int(aDrawIndex) * 6;
+    mat4 model = mat4(texelFetch(drawData, texel), texelFetch(drawData, texel + 1), texelFetch(drawData, texel + 2),
+                      texelFetch(drawData, texel + 3));
+    vec3 positionOffset = texelFetch(drawData, texel + 4).xyz;
+    vec3 positionScale = texelFetch(drawData, texel + 5).xyz;
+#endif
+    vec3 position = positionOffset + aPos.xyz * positionScale;
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = packedVertex ? octahedralDecode(aNormal.xy) : aNormal;
+#if NORMAL_MAP
+    vec3 tangent = packedVertex ? octahedralDecode(aTangent.xy) : normalize(aTangent);
+    vec3 bitangent = packedVertex ? cross(Normal, tangent) * (aPos.w * 2.0 - 1.0) : normalize(aBitangent);
+    TBN = mat3(tangent, bitangent, Normal);
+#endif
     TexCoords = aTexCoords;    
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
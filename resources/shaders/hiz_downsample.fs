@@ -0,0 +1,16 @@
+#version 330 core
+// one level of the hierarchical Z chain: each texel keeps the farthest depth of the 2x2 texels below it.
+// The level below is the only one the sampler can reach (base and max level), read with texelFetch at lod 0.
+uniform sampler2D depth;
+
+void main()
+{
+    ivec2 last = textureSize(depth, 0) - 1;
+    ivec2 source = ivec2(gl_FragCoord.xy) * 2;
+    // levels of one texel in either direction repeat it
+    float d00 = texelFetch(depth, min(source, last), 0).r;
+    float d10 = texelFetch(depth, min(source + ivec2(1, 0), last), 0).r;
+    float d01 = texelFetch(depth, min(source + ivec2(0, 1), last), 0).r;
+    float d11 = texelFetch(depth, min(source + ivec2(1, 1), last), 0).r;
+    gl_FragDepth = max(max(d00, d10), max(d01, d11));
+}
@@ -1,11 +1,15 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+// per-instance model matrix, see InstanceBuffer
+layout (location = 5) in mat4 aInstanceModel;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * aInstanceModel * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,18 @@
+#version 330 core
+// occluder depth for OcclusionCuller: positions only, plain or packed (see 2.model_lighting.vs)
+layout (location = 0) in vec4 aPos;
+
+uniform mat4 model;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(positionOffset + aPos.xyz * positionScale, 1.0);
+}
@@ -0,0 +1,67 @@
+#version 330 core
+// one point per object of OcclusionCuller, written to the object's texel of the result row: 1 when some of the
+// object's screen rectangle may be in front of the occluders, 0 when the occluders hide all of it
+layout (location = 0) in vec4 aSphere;  // world space center and radius
+
+uniform sampler2D hiZ;
+uniform int hiZLevels;
+uniform float resultWidth;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+flat out float visible;
+
+void main()
+{
+    gl_Position = vec4((float(gl_VertexID) + 0.5) / resultWidth * 2.0 - 1.0, 0.0, 0.0, 1.0);
+
+    // screen rectangle and nearest depth of the box around the sphere
+    mat4 viewProjection = projection * view;
+    vec3 boundsMin = aSphere.xyz - aSphere.w;
+    vec3 boundsMax = aSphere.xyz + aSphere.w;
+    vec3 ndcMin = vec3(1e30);
+    vec3 ndcMax = vec3(-1e30);
+    for (int i = 0; i < 8; i++)
+    {
+        vec4 clip = viewProjection * vec4(mix(boundsMin, boundsMax, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1)), 1.0);
+        // a corner behind the near plane: the box reaches the camera, keep it
+        if (clip.w <= 0.0 || clip.z < -clip.w)
+        {
+            visible = 1.0;
+            return;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc);
+        ndcMax = max(ndcMax, ndc);
+    }
+    vec2 uvMin = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 uvMax = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0);
+    float nearest = ndcMin.z * 0.5 + 0.5;
+
+    // the level where the rectangle spans at most 2x2 texels, each keeping the farthest occluder depth under it
+    vec2 extent = (uvMax - uvMin) * vec2(textureSize(hiZ, 0));
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, hiZLevels - 1);
+    ivec2 last = textureSize(hiZ, level) - 1;
+    ivec2 low = min(ivec2(uvMin * vec2(last + 1)), last);
+    ivec2 high = min(ivec2(uvMax * vec2(last + 1)), last);
+    // one level finer when the rectangle happens to fall into 2x2 texels there as well, a tighter fit near edges
+    if (level > 0)
+    {
+        ivec2 finerLast = textureSize(hiZ, level - 1) - 1;
+        ivec2 finerLow = min(ivec2(uvMin * vec2(finerLast + 1)), finerLast);
+        ivec2 finerHigh = min(ivec2(uvMax * vec2(finerLast + 1)), finerLast);
+        if (all(lessThanEqual(finerHigh - finerLow, ivec2(1))))
+        {
+            level--;
+            low = finerLow;
+            high = finerHigh;
+        }
+    }
+    float farthest = max(max(texelFetch(hiZ, low, level).r, texelFetch(hiZ, ivec2(high.x, low.y), level).r),
+                         max(texelFetch(hiZ, ivec2(low.x, high.y), level).r, texelFetch(hiZ, high, level).r));
+    visible = nearest <= farthest ? 1.0 : 0.0;
+}
@@ -10,9 +10,17 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <learnopengl/filesystem.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/gl_state.h>
 #include <learnopengl/shader_m.h>
+#include <learnopengl/shader_manager.h>
+#include <learnopengl/shader_permutations.h>
 #include <learnopengl/camera.h>
+#include <learnopengl/memory_usage.h>
 #include <learnopengl/model.h>
+#include <learnopengl/model_lod.h>
+#include <learnopengl/occlusion_culler.h>
+#include <learnopengl/render_queue.h>
 
 #include <iostream>
 
@@ -28,7 +36,9 @@ void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-unsigned int loadTexture(const char *path);
+void renderScene(GLFWwindow *window);
+
+unsigned int loadTexture(const char *path, bool flipVertically = false);
 unsigned int loadCubemap(vector<std::string> faces);
 
 // settings
@@ -54,6 +64,21 @@ struct PointLight {
     float constant;
     float linear;
     float quadratic;
+
+    // std140 form for the Lights block
+    PointLightBlock block() const
+    {
+        PointLightBlock light;
+        light.position = position;
+        light.ambient = ambient;
+        light.diffuse = diffuse;
+        light.specular = specular;
+        light.constant = constant;
+        light.linear = linear;
+        light.quadratic = quadratic;
+        light.padding = 0.0f;
+        return light;
+    }
 };
 
 
@@ -154,31 +179,93 @@ int main() {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
 
+    // what the scene creates frees its GL objects when destroyed (the models release their textures), which
+    // has to happen before glfwTerminate() destroys the context, so all of it lives in renderScene
+    renderScene(window);
 
-    // configure global opengl state
-    glEnable(GL_DEPTH_TEST);
+    programState->SaveToFile("resources/program_state.txt");
+    delete programState;
+    TextureLoader::instance().uploadRing().release();
 
-    // build and compile shaders
-    Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
-    Shader skyboxShader("resources/shaders/6.1.skybox.vs", "resources/shaders/6.1.skybox.fs");
-    Shader transpShader("resources/shaders/transparentobj.vs", "resources/shaders/transparentobj.fs");
-    Shader kantaShader("resources/shaders/kanta.vs", "resources/shaders/kanta.fs");
-    // load models
-    Model ourModelPas("resources/objects/pas/13463_Australian_Cattle_Dog_v3.obj");
-    Model ourModelLopta("resources/objects/ball/10536_soccerball_V1_iterations-2.obj");
-    Model ourModelKutija("resources/objects/kutija/14028_Wood_Fruit_Crate_v1_l1.obj");
-    Model ourModelPomorandza("resources/objects/pomorandza/10195_Orange-L2.obj");
 
-    // svetla kocka
+    glfwTerminate();
+    return 0;
+}
+
+// loads the scene and renders it until the window is closed
+void renderScene(GLFWwindow *window) {
+    // configure global opengl state; binds and state changes go through the shadow, which drops redundant ones
+    GLState &glState = GLState::instance();
+    glState.setDepthTest(true);
+
+    // start reading all models on worker threads, the shaders below compile while they import.
+    // imports are optimized for the vertex cache; nothing reads the geometry back after upload, so the meshes drop
+    // their CPU copies, and all of them use the packed 20-byte vertex layout the lighting shader decodes
+    MeshOptions sceneMeshes;
+    sceneMeshes.keepCPUData = false;
+    sceneMeshes.packVertices = true;
+    double loadStart = glfwGetTime();
+    size_t peakBeforeLoad = MemoryUsage::peakResidentKiB();
+    ThreadPool loaderPool;
+    std::future<ModelData> pasData = Model::LoadAsync(loaderPool, "resources/objects/pas/13463_Australian_Cattle_Dog_v3.obj", sceneMeshes);
+    std::future<ModelData> loptaData = Model::LoadAsync(loaderPool, "resources/objects/ball/10536_soccerball_V1_iterations-2.obj", sceneMeshes);
+    std::future<ModelData> kutijaData = Model::LoadAsync(loaderPool, "resources/objects/kutija/14028_Wood_Fruit_Crate_v1_l1.obj", sceneMeshes);
+    std::future<ModelData> pomorandzaData = Model::LoadAsync(loaderPool, "resources/objects/pomorandza/10195_Orange-L2.obj", sceneMeshes);
+    // the bench ships as an authored pair of levels of detail
+    std::future<vector<ModelData>> klupaData = ModelLOD::LoadAsync(loaderPool, {"resources/objects/klupa/Bench_HighRes.obj",
+                                                                                "resources/objects/klupa/Bench_LowRes.obj"}, sceneMeshes);
+
+    // submit every program's compile and link work up front, from the program binary cache where possible;
+    // each is finished on first use, the driver compiles them while the models load. The models are lit by
+    // variants of the lighting shader, compiled when a draw first needs them
+    double shaderStart = glfwGetTime();
+    ShaderManager shaders;
+    ShaderPermutations lighting(shaders, "resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
+    Shader &skyboxShader = shaders.load("resources/shaders/6.1.skybox.vs", "resources/shaders/6.1.skybox.fs");
+    Shader &transpShader = shaders.load("resources/shaders/transparentobj.vs", "resources/shaders/transparentobj.fs");
+    Shader &kantaShader = shaders.load("resources/shaders/kanta.vs", "resources/shaders/kanta.fs");
+    Shader &lightCubeShader = shaders.load("resources/shaders/light_cube.vs", "resources/shaders/light_cube.fs");
+    double shaderSubmitMs = (glfwGetTime() - shaderStart) * 1000.0;
+    // load models: GL upload happens here on the context thread once each model's CPU data is ready
+    Model ourModelPas(pasData.get(), false, sceneMeshes);
+    Model ourModelLopta(loptaData.get(), false, sceneMeshes);
+    Model ourModelKutija(kutijaData.get(), false, sceneMeshes);
+    Model ourModelPomorandza(pomorandzaData.get(), false, sceneMeshes);
+    ModelLOD ourModelKlupa(klupaData.get(), false, sceneMeshes);
+    for (Model *model : { &ourModelPas, &ourModelLopta, &ourModelKutija, &ourModelPomorandza })
+        model->SetShaderTextureNamePrefix("material.");
+    ourModelKlupa.SetShaderTextureNamePrefix("material.");
+    // the dog's bump map is a greyscale height map, not a tangent space normal map
+    ourModelPas.normalMapping = false;
+    // their geometry never changes, so all of it is merged into one arena and drawn in multi-draw batches
+    MeshArena staticMeshes;
+    vector<Mesh*> staticMeshList;
+    for (Model *model : { &ourModelPas, &ourModelLopta, &ourModelKutija, &ourModelPomorandza })
+        model->CollectMeshes(staticMeshList);
+    ourModelKlupa.CollectMeshes(staticMeshList);
+    staticMeshes.build(staticMeshList);
+    std::cout << "Loaded models in " << (glfwGetTime() - loadStart) * 1000.0 << " ms using "
+              << loaderPool.size() << " loader threads, peak resident memory " << peakBeforeLoad / 1024 << " MiB before, "
+              << MemoryUsage::peakResidentKiB() / 1024 << " MiB after (" << MemoryUsage::residentKiB() / 1024 << " MiB now)" << std::endl;
+    size_t indexBytes = 0, unsignedIntIndexBytes = 0;
+    for (const Model *model : { &ourModelPas, &ourModelLopta, &ourModelKutija, &ourModelPomorandza })
+        model->IndexMemory(indexBytes, unsignedIntIndexBytes);
+    for (int level = 0; level < ourModelKlupa.LevelCount(); level++)
+        ourModelKlupa.Level(level).IndexMemory(indexBytes, unsignedIntIndexBytes);
+    shaders.poll();
+    std::cout << "Shaders submitted in " << shaderSubmitMs << " ms, " << shaders.size() - shaders.pendingCount() << " of "
+              << shaders.size() << " finished while the models loaded" << std::endl;
+    std::cout << "Index buffers: " << indexBytes / 1024 << " KiB, " << (unsignedIntIndexBytes - indexBytes) / 1024
+              << " KiB saved by 16-bit indices" << std::endl;
 
-    Shader lightCubeShader("resources/shaders/light_cube.vs", "resources/shaders/light_cube.fs");
+    // svetla kocka
 
 
 
 
 
 
-    glEnable(GL_DEPTH_TEST);
+    glState.setDepthTest(true);
 
     // setting coordinates:
 
@@ -305,12 +392,12 @@ int main() {
     glGenBuffers(1, &kantaVBO);
     glGenBuffers(1, &kantaEBO);
 
-    glBindVertexArray(kantaVAO);
+    glState.bindVertexArray(kantaVAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, kantaVBO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, kantaVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(verticesKanta), verticesKanta, GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, kantaEBO);
+    glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, kantaEBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
     // position attribute
@@ -323,43 +410,30 @@ int main() {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
-    unsigned int lightCubeVAO, lightCubeVBO;
-    glGenVertexArrays(1, &lightCubeVAO);
-    glBindVertexArray(lightCubeVAO);
-
-    glGenBuffers(1, &lightCubeVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, lightCubeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(CubeVertices), CubeVertices, GL_STATIC_DRAW);
-
-    glBindVertexArray(lightCubeVAO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    // texture coord attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-
+    // the light cube as a one-mesh model, so all light markers go out in one instanced draw
+    ModelData lightCubeData;
+    lightCubeData.path = "light_cube";
+    lightCubeData.loaded = true;
+    lightCubeData.meshes.resize(1);
+    for (unsigned int i = 0; i < 36; i++)
+    {
+        const float *cubeVertex = &CubeVertices[i * 8];
+        Vertex vertex;
+        vertex.Position = glm::vec3(cubeVertex[0], cubeVertex[1], cubeVertex[2]);
+        vertex.Normal = glm::vec3(cubeVertex[3], cubeVertex[4], cubeVertex[5]);
+        vertex.TexCoords = glm::vec2(cubeVertex[6], cubeVertex[7]);
+        vertex.Tangent = vertex.Bitangent = glm::vec3(0.0f);
+        lightCubeData.meshes[0].vertices.push_back(vertex);
+        lightCubeData.meshes[0].indices.push_back(i);
+    }
+    Model lightCube(std::move(lightCubeData));
 
     // skybox VAO
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+    glState.bindVertexArray(skyboxVAO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
@@ -368,22 +442,20 @@ int main() {
     unsigned int transparentRoseVAO, transparentRoseVBO;
     glGenVertexArrays(1, &transparentRoseVAO);
     glGenBuffers(1, &transparentRoseVBO);
-    glBindVertexArray(transparentRoseVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, transparentRoseVBO);
+    glState.bindVertexArray(transparentRoseVAO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, transparentRoseVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
 
 
 
     // texture loading
-    stbi_set_flip_vertically_on_load(true);
-
-    unsigned int transparentRoseTexture = loadTexture(FileSystem::getPath("resources/textures/belaRuza.png").c_str());
-    unsigned  int kantaTexture = loadTexture(FileSystem::getPath("resources/textures/kanta.png").c_str());
+    unsigned int transparentRoseTexture = loadTexture(FileSystem::getPath("resources/textures/belaRuza.png").c_str(), true);
+    unsigned  int kantaTexture = loadTexture(FileSystem::getPath("resources/textures/kanta.png").c_str(), true);
 
     //pozicije svetlecih kocki
     //NE MENJAJ !!!!!!!!!!!!!!!!!!!!
@@ -394,7 +466,6 @@ int main() {
             glm::vec3(6.0f ,-7.0 ,6.8f) //lopta
     };
     //------------------------------------------------
-    stbi_set_flip_vertically_on_load(false);
 
 
     vector<std::string> faces
@@ -416,7 +487,31 @@ int main() {
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
 
-    stbi_set_flip_vertically_on_load(true);
+    // edits to the shader sources are picked up while running
+    shaders.watch();
+
+    // per-frame blocks shared by all programs, see uniform_blocks.h
+    UniformBuffer<CameraBlock> cameraBuffer(UniformBlocks::CAMERA);
+    UniformBuffer<LightsBlock> lightsBuffer(UniformBlocks::LIGHTS);
+    // uniform calls, state changes and GL state calls are summed over about a second and reported as a per-frame average
+    UniformCache::endFrame();
+    UniformCache::FrameStats uniformStats;
+    RenderQueue renderQueue;
+    RenderQueue::FrameStats queueStats;
+    MeshArena::FrameStats arenaStats;
+    FrustumCuller culler;
+    FrustumCuller::FrameStats cullStats;
+    // the dog and the crate hide what is behind them from the GPU's view of the last frame, see OcclusionCuller
+    OcclusionCuller occlusion(shaders, "resources/shaders/");
+    OcclusionCuller::FrameStats occlusionStats;
+    // triangles of the visible models as submitted, and as they would be with every model at its most detailed level
+    size_t lodTriangles = 0, fullDetailTriangles = 0;
+    vector<glm::mat4> visibleLightCubes;
+    double submitMs = 0.0;
+    glState.endFrame();
+    GLState::FrameStats stateStats;
+    unsigned int uniformFrames = 0;
+    float uniformReportTime = glfwGetTime();
 
 
 
@@ -430,6 +525,23 @@ int main() {
         // input
         processInput(window);
 
+        // rebuild the programs whose sources were edited since the last frame
+        shaders.update();
+
+        // upload textures whose decode finished since the last frame, a few at a time to avoid hitches
+        TextureLoader::instance().pump(4);
+        PixelUploadRing::FrameStats uploadStats = TextureLoader::instance().uploadRing().endFrame();
+        if (uploadStats.uploads > 0)
+            std::cout << "Texture uploads: " << uploadStats.uploads << " images, " << uploadStats.bytes / 1024 << " KiB, "
+                      << uploadStats.submitMs << " ms on CPU (" << uploadStats.fenceWaitMs << " ms fence wait), ~"
+                      << uploadStats.savedMs() << " ms saved vs. direct glTexImage2D" << std::endl;
+        if (uploadStats.uploads > 0 && TextureLoader::instance().pendingCount() == 0)
+        {
+            TextureRegistry::Stats textureStats = TextureRegistry::instance().stats();
+            std::cout << "Texture registry: " << textureStats.textures << " textures, " << textureStats.hits << " hits, "
+                      << textureStats.misses << " misses, " << textureStats.residentBytes / 1024 << " KiB resident" << std::endl;
+        }
+
 
         // render
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
@@ -446,67 +558,80 @@ int main() {
         pointLight.constant = 0.8f;
         pointLight.linear = 0.0014f;
         pointLight.quadratic = 0.000007f;
-        ourShader.use();
 
+        // lights are shared by every program through the Lights block, filled once per frame
+        LightsBlock lights;
 
         // svetlo za kutiju i pomorandzu
         pointLight.position = glm::vec3(13.0f,1.8f,7.8f);
-        ourShader.setVec3("pointLight.position", pointLight.position);
-        ourShader.setVec3("pointLight.ambient", glm::vec3(0.1, 0.5 , sin(glfwGetTime()*1.5)+0.2));
-        ourShader.setVec3("pointLight.diffuse", glm::vec3(0.1, sin(glfwGetTime()*1.5), 0.7));
-        ourShader.setVec3("pointLight.specular", pointLight.specular);
-        ourShader.setFloat("pointLight.constant", pointLight.constant);
-        ourShader.setFloat("pointLight.linear", pointLight.linear + 0.05);
-        ourShader.setFloat("pointLight.quadratic", pointLight.quadratic + 0.05);
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
+        lights.pointLights[0] = pointLight.block();
+        lights.pointLights[0].ambient = glm::vec3(0.1, 0.5 , sin(glfwGetTime()*1.5)+0.2);
+        lights.pointLights[0].diffuse = glm::vec3(0.1, sin(glfwGetTime()*1.5), 0.7);
+        lights.pointLights[0].linear = pointLight.linear + 0.05;
+        lights.pointLights[0].quadratic = pointLight.quadratic + 0.05;
 
         // svetlo za psa
         pointLight.position = glm::vec3(12.0f,-2.0f,-3.8f);
-        ourShader.setVec3("pointLight1.position", pointLight.position);
-        ourShader.setVec3("pointLight1.ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight1.diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight1.specular", pointLight.specular);
-        ourShader.setFloat("pointLight1.constant", pointLight.constant);
-        ourShader.setFloat("pointLight1.linear", pointLight.linear);
-        ourShader.setFloat("pointLight1.quadratic", pointLight.quadratic);
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
+        lights.pointLights[1] = pointLight.block();
 
 
         //svetlo za loptu
         glm::vec3 lopta_kordinate = glm::vec3(6.0f + move_ball_far * pow(glfwGetTime()/2,2),-7.0 + move_rotate * 3 * sin(glfwGetTime()),6.8f );
         pointLight.position = glm::vec3(lopta_kordinate + glm::vec3(0,3,0));
-        ourShader.setVec3("pointLight2.position", pointLight.position);
-        ourShader.setVec3("pointLight2.ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight2.diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight2.specular", pointLight.specular);
-        ourShader.setFloat("pointLight2.constant", pointLight.constant);
-        ourShader.setFloat("pointLight2.linear", pointLight.linear);
-        ourShader.setFloat("pointLight2.quadratic", pointLight.quadratic);
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
+        lights.pointLights[2] = pointLight.block();
 
         //lampa
-        ourShader.setVec3("spotLight.position", glm::vec3(programState->camera.Position));
-        ourShader.setVec3("spotLight.direction", programState->camera.Front);
-        ourShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        ourShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-        ourShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-        ourShader.setFloat("spotLight.constant", 0.5f);
-        ourShader.setFloat("spotLight.linear", 0.03);
-        ourShader.setFloat("spotLight.quadratic", 0.032);
-        ourShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        ourShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(17.5f)));
-
-
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom), (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-        // rendering loaded models
-
+        SpotLightBlock &spotLight = lights.spotLight;
+        spotLight.position = programState->camera.Position;
+        spotLight.direction = programState->camera.Front;
+        spotLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+        spotLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+        spotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+        spotLight.constant = 0.5f;
+        spotLight.linear = 0.03;
+        spotLight.quadratic = 0.032;
+        spotLight.cutOff = glm::cos(glm::radians(12.5f));
+        spotLight.outerCutOff = glm::cos(glm::radians(17.5f));
+        lightsBuffer.update(lights);
+
+
+        // camera matrices of every program, one buffer update per frame
+        CameraBlock camera;
+        camera.projection = glm::perspective(glm::radians(programState->camera.Zoom), (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+        camera.view = programState->camera.GetViewMatrix();
+        camera.viewPosition = programState->camera.Position;
+        camera.padding = 0.0f;
+        cameraBuffer.update(camera);
+
+        // the frame's draws are queued and run sorted by program, textures and VAO
+        double submitStart = glfwGetTime();
+        renderQueue.begin(100.0f);
+        staticMeshes.begin();
+        occlusion.begin();
+
+        // objects are placed below with their world space bounding spheres and submitted once all spheres have
+        // been tested against the view frustum together; those the last occlusion results found hidden are skipped
+        Frustum frustum = Frustum::fromMatrix(camera.projection * camera.view);
+
+        auto cull = [&culler, &occlusion](const glm::vec3 &center, float radius, std::function<void()> visible) {
+            if (occlusion.add(center, radius))
+                culler.add(center, radius, std::move(visible));
+        };
+
+        // rendering loaded models, each with only the lights that reach its bounding sphere. fullDetail is the
+        // most detailed level when object is a coarser level of detail picked for this frame
+        auto drawLit = [&lighting, &lights, &renderQueue, &staticMeshes, &cull, &lodTriangles, &fullDetailTriangles](
+                           Model &object, const glm::mat4 &model, const Model *fullDetail = nullptr) {
+            glm::vec3 center;
+            float radius;
+            object.BoundingSphere(model, center, radius);
+            cull(center, radius, [&, center, radius, model, fullDetail]() {
+                object.Submit(renderQueue, staticMeshes, lighting, LightingFeatures::select(lights, center, radius), model,
+                              glm::length(center - programState->camera.Position));
+                lodTriangles += object.TriangleCount();
+                fullDetailTriangles += (fullDetail ? fullDetail : &object)->TriangleCount();
+            });
+        };
 
         //model matrica
         glm::mat4 model = glm::mat4(1.0f);
@@ -519,8 +644,8 @@ int main() {
         model = glm::translate(model, glm::vec3(12.0f,-8.0f,-5.8f));
         model = glm::rotate(model,glm::radians(-90.0f),glm::vec3(1.0,0.0,0.0));
         model = glm::scale(model, glm::vec3(0.19f,0.19f,0.19f));
-        ourShader.setMat4("model", model);
-        ourModelPas.Draw(ourShader);
+        drawLit(ourModelPas, model);
+        occlusion.addOccluder(ourModelPas, model, &staticMeshes);
 
 
         //LOPTA
@@ -528,8 +653,7 @@ int main() {
         model = glm::translate(model, lopta_kordinate);
         model = glm::rotate(model,move_rotate * float(glfwGetTime()/2.0),glm::vec3(0.0,1.0,0.0));
         model = glm::scale(model, glm::vec3(0.1f,0.1f,0.1f));
-        ourShader.setMat4("model", model);
-        ourModelLopta.Draw(ourShader);
+        drawLit(ourModelLopta, model);
 
         //KUTIJA
         model = glm::mat4(1.0f);
@@ -537,8 +661,8 @@ int main() {
         model = glm::rotate(model,glm::radians(-90.0f),glm::vec3(1.0,0,0.0));
         model = glm::rotate(model,glm::radians(45.0f),glm::vec3(0.0,0.0,1.0));
         model = glm::scale(model, glm::vec3(0.03f,0.03f,0.03f));
-        ourShader.setMat4("model", model);
-        ourModelKutija.Draw(ourShader);
+        drawLit(ourModelKutija, model);
+        occlusion.addOccluder(ourModelKutija, model, &staticMeshes);
 
         //POMORANDZA
         model = glm::mat4(1.0f);
@@ -546,49 +670,60 @@ int main() {
         model = glm::rotate(model,glm::radians(-90.0f),glm::vec3(1.0,0,0.0));
         model = glm::rotate(model,glm::radians(45.0f),glm::vec3(0.0,0.0,1.0));
         model = glm::scale(model, glm::vec3(0.03f,0.03f,0.03f));
-        ourShader.setMat4("model", model);
-        ourModelPomorandza.Draw(ourShader);
+        drawLit(ourModelPomorandza, model);
+
+        //KLUPA
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(5.0f,-8.5f,-7.0f));
+        model = glm::scale(model, glm::vec3(0.03f,0.03f,0.03f));
+        drawLit(ourModelKlupa.Select(model, programState->camera.Position, camera.projection, (float) SCR_HEIGHT), model,
+                &ourModelKlupa.Level(0));
 
 
 
 
         //RUZA
-
-        transpShader.use();
-        projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                      (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-        view = programState->camera.GetViewMatrix();
         model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(9.5f,-8.50f,-7.8f));
         model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(0.0, 0.0, 1.0));
         model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(0.0, 1.0, 0.0));
         model = glm::scale(model, glm::vec3(2.5f, 2.5f, 2.5f));
-        transpShader.setMat4("model", model);
-        transpShader.setMat4("projection", projection);
-        transpShader.setMat4("view", view);
-
-        glBindVertexArray(transparentRoseVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, transparentRoseTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        // the quad spans x 0..1, y -0.5..0.5
+        cull(glm::vec3(model * glm::vec4(0.5f, 0.0f, 0.0f, 1.0f)), 0.71f * 2.5f, [&, model]() {
+            RenderQueue::Draw rose;
+            rose.pass = RenderQueue::ALPHA_TESTED_PASS;
+            rose.shader = &transpShader;
+            rose.vao = transparentRoseVAO;
+            rose.depth = glm::length(glm::vec3(model[3]) - programState->camera.Position);
+            rose.addTexture(GL_TEXTURE_2D, transparentRoseTexture);
+            rose.issue = [model](Shader &shader) {
+                shader.setMat4("model", model);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            };
+            renderQueue.submit(std::move(rose));
+        });
 
 
 
 
         //KANTA
-        glBindTexture(GL_TEXTURE_2D, kantaTexture);
-        kantaShader.use();
-        projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        view = programState->camera.GetViewMatrix();
         model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(-10.5f, -10.6f, 32.0f));
         model = glm::scale(model,glm::vec3(6.0f, 6.0f, 6.0f));
-
-        kantaShader.setMat4("model", model);
-        kantaShader.setMat4("projection", projection);
-        kantaShader.setMat4("view", view);
-        glBindVertexArray(kantaVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        // the quad spans -0.5..0.5 around its origin
+        cull(glm::vec3(model[3]), 0.71f * 6.0f, [&, model]() {
+            RenderQueue::Draw kanta;
+            kanta.pass = RenderQueue::ALPHA_TESTED_PASS;
+            kanta.shader = &kantaShader;
+            kanta.vao = kantaVAO;
+            kanta.depth = glm::length(glm::vec3(model[3]) - programState->camera.Position);
+            kanta.addTexture(GL_TEXTURE_2D, kantaTexture);
+            kanta.issue = [model](Shader &shader) {
+                shader.setMat4("model", model);
+                glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            };
+            renderQueue.submit(std::move(kanta));
+        });
 
 
 
@@ -596,37 +731,124 @@ int main() {
         //---------------------------
 
 
-        lightCubeShader.use();
-        lightCubeShader.setMat4("projection", projection);
-        lightCubeShader.setMat4("view", view);
-
-
-        glBindVertexArray(lightCubeVAO);
+        // every light cube is culled on its own, the visible ones go out as one instanced draw
+        visibleLightCubes.clear();
         for (unsigned int i = 0; i < 3; i++)
         {
             model = glm::mat4(1.0f);
             model = glm::translate(model, pointLightPositions[i]);
             model = glm::scale(model, glm::vec3(0.08f)); // Make it a smaller cube
-            lightCubeShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            cull(pointLightPositions[i], 0.87f * 0.08f, [&visibleLightCubes, model]() {
+                visibleLightCubes.push_back(model);
+            });
+        }
+
+        FrustumCuller::FrameStats frameCulling = culler.run(frustum);
+        cullStats.visible += frameCulling.visible;
+        cullStats.culled += frameCulling.culled;
+        // tests this frame's spheres against this frame's occluders, for the next frames to use
+        OcclusionCuller::FrameStats frameOcclusion = occlusion.render();
+        occlusionStats.occluders += frameOcclusion.occluders;
+        occlusionStats.tested += frameOcclusion.tested;
+        occlusionStats.occluded += frameOcclusion.occluded;
+        occlusionStats.pending += frameOcclusion.pending;
+
+        if (!visibleLightCubes.empty())
+        {
+            RenderQueue::Draw lightCubes;
+            lightCubes.shader = &lightCubeShader;
+            lightCubes.vao = lightCube.meshes[0].VAO;
+            lightCubes.issue = [&lightCube, &visibleLightCubes](Shader &shader) {
+                lightCube.DrawInstanced(shader, visibleLightCubes.data(), visibleLightCubes.size());
+            };
+            renderQueue.submit(std::move(lightCubes));
         }
 
         //-----------------------------------------------
 
-        // drawing skybox as last
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
+        // skybox after everything opaque, tested with GL_LEQUAL so it passes where the depth buffer is still clear;
+        // the skybox shader strips the translation from the Camera block's view
+        RenderQueue::Draw skybox;
+        skybox.pass = RenderQueue::SKY_PASS;
+        skybox.shader = &skyboxShader;
+        skybox.vao = skyboxVAO;
+        skybox.addTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+        skybox.issue = [](Shader &) {
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+        };
+        renderQueue.submit(std::move(skybox));
+
+        MeshArena::FrameStats frameArena = staticMeshes.flush(renderQueue);
+        arenaStats.draws += frameArena.draws;
+        arenaStats.batches += frameArena.batches;
+        arenaStats.calls += frameArena.calls;
+        RenderQueue::FrameStats frameQueue = renderQueue.execute();
+        submitMs += (glfwGetTime() - submitStart) * 1000.0;
+        queueStats.draws += frameQueue.draws;
+        queueStats.submitted.programs += frameQueue.submitted.programs;
+        queueStats.submitted.textures += frameQueue.submitted.textures;
+        queueStats.submitted.vaos += frameQueue.submitted.vaos;
+        queueStats.sorted.programs += frameQueue.sorted.programs;
+        queueStats.sorted.textures += frameQueue.sorted.textures;
+        queueStats.sorted.vaos += frameQueue.sorted.vaos;
+
+        if (shaderStart > 0.0 && shaders.pendingCount() == 0)
+        {
+            ProgramCache::Stats programStats = ProgramCache::stats();
+            std::cout << "Shaders ready " << (glfwGetTime() - shaderStart) * 1000.0 << " ms after submission: " << programStats.hits
+                      << " from the program binary cache (" << programStats.loadMs << " ms), " << programStats.misses
+                      << " compiled from source";
+            if (programStats.rejected > 0)
+                std::cout << ", " << programStats.rejected << " cached binaries rejected by the driver";
+            std::cout << std::endl;
+            shaderStart = 0.0;
+        }
 
-        // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
+        // LEARNOPENGL_GL_STATE_VALIDATE=1 checks the state shadow against the context once a frame
+        if (glState.validation())
+            glState.validate();
+
+        GLState::FrameStats frameState = glState.endFrame();
+        stateStats.issued += frameState.issued;
+        stateStats.filtered += frameState.filtered;
+        UniformCache::FrameStats frameUniforms = UniformCache::endFrame();
+        uniformStats.issued += frameUniforms.issued;
+        uniformStats.skipped += frameUniforms.skipped;
+        uniformFrames++;
+        if (currentFrame - uniformReportTime >= 1.0f)
+        {
+            std::cout << "Uniforms per frame: " << uniformStats.issued / uniformFrames << " issued, "
+                      << uniformStats.skipped / uniformFrames << " skipped" << std::endl;
+            std::cout << "State changes per frame over " << queueStats.draws / uniformFrames << " draws, submission order -> sorted: programs "
+                      << queueStats.submitted.programs / uniformFrames << " -> " << queueStats.sorted.programs / uniformFrames
+                      << ", textures " << queueStats.submitted.textures / uniformFrames << " -> " << queueStats.sorted.textures / uniformFrames
+                      << ", VAOs " << queueStats.submitted.vaos / uniformFrames << " -> " << queueStats.sorted.vaos / uniformFrames << std::endl;
+            std::cout << "GL state calls per frame: " << stateStats.issued / uniformFrames << " issued, "
+                      << stateStats.filtered / uniformFrames << " filtered as redundant" << std::endl;
+            std::cout << "Static meshes per frame: " << arenaStats.draws / uniformFrames << " draws in "
+                      << arenaStats.batches / uniformFrames << " batches, " << arenaStats.calls / uniformFrames
+                      << " GL draw calls; submission " << submitMs / uniformFrames << " ms CPU" << std::endl;
+            std::cout << "Frustum culling per frame: " << cullStats.visible / uniformFrames << " objects visible, "
+                      << cullStats.culled / uniformFrames << " culled" << std::endl;
+            if (occlusion.isAvailable())
+                std::cout << "Occlusion culling per frame: " << occlusionStats.occluded / uniformFrames << " of "
+                          << occlusionStats.tested / uniformFrames << " tested objects hidden by "
+                          << occlusionStats.occluders / uniformFrames << " occluders, "
+                          << occlusionStats.pending / uniformFrames << " drawn without a result" << std::endl;
+            std::cout << "Triangles per frame: " << lodTriangles / uniformFrames << " submitted with LOD, "
+                      << fullDetailTriangles / uniformFrames << " at full detail; bench at level "
+                      << ourModelKlupa.CurrentLevel() << ", " << ourModelKlupa.Switches() << " level switches so far" << std::endl;
+            uniformStats = UniformCache::FrameStats();
+            queueStats = RenderQueue::FrameStats();
+            stateStats = GLState::FrameStats();
+            arenaStats = MeshArena::FrameStats();
+            cullStats = FrustumCuller::FrameStats();
+            occlusionStats = OcclusionCuller::FrameStats();
+            lodTriangles = fullDetailTriangles = 0;
+            submitMs = 0.0;
+            uniformFrames = 0;
+            uniformReportTime = currentFrame;
+        }
 
 
 
@@ -634,13 +856,6 @@ int main() {
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
-
-    programState->SaveToFile("resources/program_state.txt");
-    delete programState;
-
-
-    glfwTerminate();
-    return 0;
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -723,73 +938,17 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 }
 
 
+// faces are decoded on the texture loader's worker threads, the cube map samples grey until all six arrived.
+// shared through the TextureRegistry like every other texture
 unsigned int loadCubemap(vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    return TextureRegistry::instance().acquireCubemap(faces);
 }
 
 
-unsigned int loadTexture(char const * path)
+// decoded asynchronously like loadCubemap; images with alpha are clamped to the edge to prevent semi-transparent
+// borders, due to interpolation the sampler would otherwise take texels from the next repeat
+unsigned int loadTexture(char const * path, bool flipVertically)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return TextureRegistry::instance().acquire2D(path, flipVertically, true);
 }
-
-
-
@@ -0,0 +1,372 @@
+#ifndef TOOLS_BC_ENCODER_H
+#define TOOLS_BC_ENCODER_H
+
+#include <learnopengl/baked_texture.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// CPU block compression for the texture baker. Every 4x4 texel block is encoded independently:
+//   BC1  colour endpoints along the block's principal axis, refined once by least squares, 4-colour mode only
+//   BC4  (the alpha half of BC3 and both halves of BC5) min/max endpoints, 8-value mode
+// Blocks hanging over the edge of a level repeat the last row/column. decodeLevel() is the reference decoder,
+// used by the baker to report the error a compressed level introduces.
+class BlockEncoder
+{
+public:
+    // compresses one level of 8-bit texels with the given component count. BC1 takes RGB (grey is replicated),
+    // BC3 RGB plus alpha, BC5 the first two components.
+    static std::vector<unsigned char> encodeLevel(BakedFormat format, const unsigned char *pixels, int width, int height, int channels)
+    {
+        std::vector<unsigned char> blocks(BakedTexture::levelSize(format, width, height));
+        unsigned char *out = blocks.data();
+        for (int by = 0; by < height; by += 4)
+        {
+            for (int bx = 0; bx < width; bx += 4)
+            {
+                unsigned char rgba[16][4];
+                fetchBlock(pixels, width, height, channels, bx, by, rgba);
+                switch (format)
+                {
+                    case BAKED_BC1:
+                        encodeColour(rgba, out);
+                        break;
+                    case BAKED_BC3:
+                        encodeChannel(rgba, 3, out);
+                        encodeColour(rgba, out + 8);
+                        break;
+                    case BAKED_BC5:
+                        encodeChannel(rgba, 0, out);
+                        encodeChannel(rgba, 1, out + 8);
+                        break;
+                    default:
+                        break;
+                }
+                out += BakedTexture::blockBytes(format);
+            }
+        }
+        return blocks;
+    }
+
+    // expands a compressed level back to RGBA8; BC1 decodes with alpha 255, BC5 as (R, G, 0, 255)
+    static std::vector<unsigned char> decodeLevel(BakedFormat format, const unsigned char *blocks, int width, int height)
+    {
+        std::vector<unsigned char> pixels((size_t)width * height * 4);
+        for (int by = 0; by < height; by += 4)
+        {
+            for (int bx = 0; bx < width; bx += 4)
+            {
+                unsigned char rgba[16][4];
+                for (int i = 0; i < 16; i++)
+                {
+                    rgba[i][0] = rgba[i][1] = rgba[i][2] = 0;
+                    rgba[i][3] = 255;
+                }
+                switch (format)
+                {
+                    case BAKED_BC1:
+                        decodeColour(blocks, rgba);
+                        break;
+                    case BAKED_BC3:
+                        decodeChannel(blocks, 3, rgba);
+                        decodeColour(blocks + 8, rgba);
+                        break;
+                    case BAKED_BC5:
+                        decodeChannel(blocks, 0, rgba);
+                        decodeChannel(blocks + 8, 1, rgba);
+                        break;
+                    default:
+                        break;
+                }
+                blocks += BakedTexture::blockBytes(format);
+                for (int y = 0; y < 4 && by + y < height; y++)
+                    for (int x = 0; x < 4 && bx + x < width; x++)
+                        std::copy(rgba[y * 4 + x], rgba[y * 4 + x] + 4, &pixels[((size_t)(by + y) * width + bx + x) * 4]);
+            }
+        }
+        return pixels;
+    }
+
+    // the RGBA the encoders see for one texel: grey is replicated into RGB, except that grey+alpha keeps
+    // its two channels in R and G (for BC5) while alpha also goes to A
+    static void expandTexel(const unsigned char *texel, int channels, unsigned char rgba[4])
+    {
+        if (channels <= 2)
+        {
+            rgba[0] = rgba[2] = texel[0];
+            rgba[1] = channels == 2 ? texel[1] : texel[0];
+            rgba[3] = channels == 2 ? texel[1] : 255;
+        }
+        else
+        {
+            rgba[0] = texel[0];
+            rgba[1] = texel[1];
+            rgba[2] = texel[2];
+            rgba[3] = channels == 4 ? texel[3] : 255;
+        }
+    }
+
+private:
+    static void fetchBlock(const unsigned char *pixels, int width, int height, int channels, int bx, int by, unsigned char rgba[16][4])
+    {
+        for (int y = 0; y < 4; y++)
+        {
+            for (int x = 0; x < 4; x++)
+            {
+                int sx = std::min(bx + x, width - 1);
+                int sy = std::min(by + y, height - 1);
+                expandTexel(pixels + ((size_t)sy * width + sx) * channels, channels, rgba[y * 4 + x]);
+            }
+        }
+    }
+
+    static uint16_t packColour(const float colour[3])
+    {
+        int r = (int)std::lround(std::min(255.0f, std::max(0.0f, colour[0])) * 31.0f / 255.0f);
+        int g = (int)std::lround(std::min(255.0f, std::max(0.0f, colour[1])) * 63.0f / 255.0f);
+        int b = (int)std::lround(std::min(255.0f, std::max(0.0f, colour[2])) * 31.0f / 255.0f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    static void unpackColour(uint16_t packed, int colour[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        colour[0] = (r << 3) | (r >> 2);
+        colour[1] = (g << 2) | (g >> 4);
+        colour[2] = (b << 3) | (b >> 2);
+    }
+
+    // the 4-colour palette of a block whose first endpoint is greater than its second
+    static void colourPalette(uint16_t c0, uint16_t c1, int palette[4][3])
+    {
+        unpackColour(c0, palette[0]);
+        unpackColour(c1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+    }
+
+    // picks the nearest palette entry per texel, returns the summed squared error
+    static int assignColourIndices(const unsigned char rgba[16][4], uint16_t c0, uint16_t c1, unsigned char indices[16])
+    {
+        int palette[4][3];
+        colourPalette(c0, c1, palette);
+        int total = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestError = 1 << 30;
+            for (int p = 0; p < 4; p++)
+            {
+                int dr = rgba[i][0] - palette[p][0], dg = rgba[i][1] - palette[p][1], db = rgba[i][2] - palette[p][2];
+                int error = dr * dr + dg * dg + db * db;
+                if (error < bestError)
+                {
+                    best = p;
+                    bestError = error;
+                }
+            }
+            indices[i] = (unsigned char)best;
+            total += bestError;
+        }
+        return total;
+    }
+
+    // orders the endpoints for 4-colour mode. Equal endpoints would select the 3-colour mode, where
+    // index 3 is transparent black, so such blocks use index 0 throughout.
+    static void writeColourBlock(uint16_t c0, uint16_t c1, unsigned char indices[16], unsigned char *out)
+    {
+        if (c0 < c1)
+        {
+            std::swap(c0, c1);
+            static const unsigned char swapped[4] = { 1, 0, 3, 2 };
+            for (int i = 0; i < 16; i++)
+                indices[i] = swapped[indices[i]];
+        }
+        if (c0 == c1)
+            std::fill(indices, indices + 16, 0);
+        uint32_t bits = 0;
+        for (int i = 0; i < 16; i++)
+            bits |= (uint32_t)indices[i] << (2 * i);
+        out[0] = (unsigned char)c0;
+        out[1] = (unsigned char)(c0 >> 8);
+        out[2] = (unsigned char)c1;
+        out[3] = (unsigned char)(c1 >> 8);
+        for (int i = 0; i < 4; i++)
+            out[4 + i] = (unsigned char)(bits >> (8 * i));
+    }
+
+    static void encodeColour(const unsigned char rgba[16][4], unsigned char *out)
+    {
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                mean[c] += rgba[i][c] / 16.0f;
+
+        float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }; // xx xy xz yy yz zz
+        for (int i = 0; i < 16; i++)
+        {
+            float d[3] = { rgba[i][0] - mean[0], rgba[i][1] - mean[1], rgba[i][2] - mean[2] };
+            covariance[0] += d[0] * d[0];
+            covariance[1] += d[0] * d[1];
+            covariance[2] += d[0] * d[2];
+            covariance[3] += d[1] * d[1];
+            covariance[4] += d[1] * d[2];
+            covariance[5] += d[2] * d[2];
+        }
+
+        // principal axis by power iteration
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[3] = {
+                covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+            };
+            float length = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+            if (length < 1e-6f)
+                break;
+            for (int c = 0; c < 3; c++)
+                axis[c] = next[c] / length;
+        }
+
+        float lowest = 1e30f, highest = -1e30f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = (rgba[i][0] - mean[0]) * axis[0] + (rgba[i][1] - mean[1]) * axis[1] + (rgba[i][2] - mean[2]) * axis[2];
+            lowest = std::min(lowest, t);
+            highest = std::max(highest, t);
+        }
+        float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        float start[3], end[3];
+        for (int c = 0; c < 3; c++)
+        {
+            start[c] = mean[c] + axis[c] * highest / axisLength2;
+            end[c] = mean[c] + axis[c] * lowest / axisLength2;
+        }
+
+        uint16_t c0 = packColour(start), c1 = packColour(end);
+        unsigned char indices[16];
+        int error = assignColourIndices(rgba, c0, c1, indices);
+
+        // least squares endpoints for the chosen indices, kept when they reduce the error
+        static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; i++)
+        {
+            float a = weights[indices[i]], b = 1.0f - a;
+            aa += a * a;
+            bb += b * b;
+            ab += a * b;
+            for (int c = 0; c < 3; c++)
+            {
+                ax[c] += a * rgba[i][c];
+                bx[c] += b * rgba[i][c];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) > 1e-6f)
+        {
+            float refinedStart[3], refinedEnd[3];
+            for (int c = 0; c < 3; c++)
+            {
+                refinedStart[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+                refinedEnd[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+            }
+            uint16_t r0 = packColour(refinedStart), r1 = packColour(refinedEnd);
+            unsigned char refinedIndices[16];
+            if (assignColourIndices(rgba, r0, r1, refinedIndices) < error)
+            {
+                c0 = r0;
+                c1 = r1;
+                std::copy(refinedIndices, refinedIndices + 16, indices);
+            }
+        }
+        writeColourBlock(c0, c1, indices, out);
+    }
+
+    static void encodeChannel(const unsigned char rgba[16][4], int channel, unsigned char *out)
+    {
+        int lowest = 255, highest = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            lowest = std::min(lowest, (int)rgba[i][channel]);
+            highest = std::max(highest, (int)rgba[i][channel]);
+        }
+        // a0 > a1 selects 8 values: a0, a1 and six interpolated between them
+        int palette[8];
+        palette[0] = highest;
+        palette[1] = lowest;
+        for (int i = 1; i <= 6; i++)
+            palette[i + 1] = ((7 - i) * highest + i * lowest) / 7;
+
+        uint64_t bits = 0;
+        for (int i = 0; i < 16 && highest != lowest; i++)
+        {
+            int best = 0, bestError = 1 << 30;
+            for (int p = 0; p < 8; p++)
+            {
+                int error = std::abs(rgba[i][channel] - palette[p]);
+                if (error < bestError)
+                {
+                    best = p;
+                    bestError = error;
+                }
+            }
+            bits |= (uint64_t)best << (3 * i);
+        }
+        out[0] = (unsigned char)highest;
+        out[1] = (unsigned char)lowest;
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = (unsigned char)(bits >> (8 * i));
+    }
+
+    static void decodeColour(const unsigned char *block, unsigned char rgba[16][4])
+    {
+        uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+        uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+        int palette[4][3];
+        colourPalette(c0, c1, palette);
+        if (c0 <= c1)
+        {
+            // 3-colour mode, only produced by other encoders
+            for (int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+        uint32_t bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                rgba[i][c] = (unsigned char)palette[(bits >> (2 * i)) & 3][c];
+    }
+
+    static void decodeChannel(const unsigned char *block, int channel, unsigned char rgba[16][4])
+    {
+        int a0 = block[0], a1 = block[1];
+        int palette[8] = { a0, a1 };
+        if (a0 > a1)
+        {
+            for (int i = 1; i <= 6; i++)
+                palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        }
+        else
+        {
+            for (int i = 1; i <= 4; i++)
+                palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+        uint64_t bits = 0;
+        for (int i = 0; i < 6; i++)
+            bits |= (uint64_t)block[2 + i] << (8 * i);
+        for (int i = 0; i < 16; i++)
+            rgba[i][channel] = (unsigned char)palette[(bits >> (3 * i)) & 7];
+    }
+};
+#endif
@@ -0,0 +1,107 @@
+#ifndef TOOLS_BENCHMARK_CONTEXT_H
+#define TOOLS_BENCHMARK_CONTEXT_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdio>
+
+// hidden window with a 3.3 core context like the application's, current on the calling thread; window() is
+// nullptr on failure. GL objects delete themselves on destruction, so the context is declared before all of them:
+// it is destroyed last and terminates GLFW only once they are gone.
+class BenchmarkContext
+{
+public:
+    BenchmarkContext(int width, int height)
+    {
+        if (!glfwInit())
+            return;
+        initialized = true;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        GLFWwindow *created = glfwCreateWindow(width, height, "benchmark", NULL, NULL);
+        if (!created)
+        {
+            printf("could not create a 3.3 core context\n");
+            return;
+        }
+        glfwMakeContextCurrent(created);
+        glfwSwapInterval(0);
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            printf("could not load GL\n");
+            return;
+        }
+        current = created;
+    }
+
+    ~BenchmarkContext()
+    {
+        if (initialized)
+            glfwTerminate();
+    }
+
+    BenchmarkContext(const BenchmarkContext &) = delete;
+    BenchmarkContext &operator=(const BenchmarkContext &) = delete;
+
+    GLFWwindow *window() const
+    {
+        return current;
+    }
+
+private:
+    bool initialized = false;
+    GLFWwindow *current = nullptr;
+};
+
+// CPU time of a block of GL calls and the GPU time of the commands it issued (GL_TIME_ELAPSED, core in 3.3)
+class BenchmarkTimer
+{
+public:
+    BenchmarkTimer()
+    {
+        glGenQueries(1, &query);
+    }
+
+    ~BenchmarkTimer()
+    {
+        glDeleteQueries(1, &query);
+    }
+
+    BenchmarkTimer(const BenchmarkTimer &) = delete;
+    BenchmarkTimer &operator=(const BenchmarkTimer &) = delete;
+
+    void begin()
+    {
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        start = std::chrono::steady_clock::now();
+    }
+
+    // returns the CPU milliseconds; waits for the GPU, the GPU milliseconds are in gpuMs()
+    double end()
+    {
+        double cpu = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        glEndQuery(GL_TIME_ELAPSED);
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        gpu = nanoseconds / 1.0e6;
+        return cpu;
+    }
+
+    double gpuMs() const
+    {
+        return gpu;
+    }
+
+private:
+    GLuint query = 0;
+    std::chrono::steady_clock::time_point start;
+    double gpu = 0.0;
+};
+#endif
@@ -0,0 +1,148 @@
+// DynamicBVH benchmark at 1000 and 100000 objects: build by insertion, per-frame update of a moving tenth of the
+// objects, and frustum, ray and box query throughput. The frustum query is compared with the flat SSE sphere test
+// FrustumCuller runs over every object.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/bvh.h>
+#include <learnopengl/frustum.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static const int UPDATE_FRAMES = 100;
+static const int FRUSTUM_QUERIES = 100;
+static const int RAY_QUERIES = 10000;
+static const int BOX_QUERIES = 10000;
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Object {
+    glm::vec3 center;
+    glm::vec3 halfSize;
+    glm::vec3 velocity;  // zero for static objects
+    int proxy;
+};
+
+static void run(size_t count)
+{
+    // constant density: about one object per 1000 cubic units
+    float extent = 10.0f * std::cbrt((float)count);
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(0.0f, extent);
+    std::uniform_real_distribution<float> size(0.25f, 1.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<Object> objects(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        objects[i].center = glm::vec3(position(random), position(random), position(random));
+        objects[i].halfSize = glm::vec3(size(random), size(random), size(random));
+        // every tenth object moves, a few units per second at 60 frames per second
+        objects[i].velocity = i % 10 == 0 ? glm::vec3(unit(random), unit(random), unit(random)) * 0.05f : glm::vec3(0.0f);
+    }
+
+    DynamicBVH tree(0.1f);
+    auto start = std::chrono::steady_clock::now();
+    for (Object &object : objects)
+        object.proxy = tree.insert(object.center - object.halfSize, object.center + object.halfSize);
+    double buildMs = millisecondsSince(start);
+
+    // moving objects bounce off the floor and fall back, like the ball in the scene
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < UPDATE_FRAMES; frame++)
+    {
+        for (Object &object : objects)
+        {
+            if (object.velocity == glm::vec3(0.0f))
+                continue;
+            object.velocity.y -= 0.002f;
+            object.center += object.velocity;
+            if (object.center.y < 0.0f)
+                object.velocity.y = std::fabs(object.velocity.y);
+            tree.update(object.proxy, object.center - object.halfSize, object.center + object.halfSize);
+        }
+    }
+    double updateMs = millisecondsSince(start) / UPDATE_FRAMES;
+
+    // a 60 degree camera in one corner looking at the middle, seeing part of the objects
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.1f, extent);
+    glm::vec3 eye(0.0f, extent * 0.5f, 0.0f);
+    Frustum frustum = Frustum::fromMatrix(projection * glm::lookAt(eye, glm::vec3(extent * 0.5f), glm::vec3(0.0f, 1.0f, 0.0f)));
+    size_t treeVisible = 0;
+    start = std::chrono::steady_clock::now();
+    for (int query = 0; query < FRUSTUM_QUERIES; query++)
+    {
+        treeVisible = 0;
+        tree.queryFrustum(frustum, [&treeVisible](int) { treeVisible++; });
+    }
+    double frustumMs = millisecondsSince(start) / FRUSTUM_QUERIES;
+
+    std::vector<float> x(count), y(count), z(count), radius(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        x[i] = objects[i].center.x;
+        y[i] = objects[i].center.y;
+        z[i] = objects[i].center.z;
+        radius[i] = glm::length(objects[i].halfSize);
+    }
+    std::vector<uint8_t> visible(count);
+    size_t flatVisible = 0;
+    start = std::chrono::steady_clock::now();
+    for (int query = 0; query < FRUSTUM_QUERIES; query++)
+        flatVisible = frustum.cullSpheres(x.data(), y.data(), z.data(), radius.data(), count, visible.data());
+    double flatMs = millisecondsSince(start) / FRUSTUM_QUERIES;
+
+    // picking rays from random points in random directions, keeping the closest box
+    std::vector<glm::vec3> origins(RAY_QUERIES), directions(RAY_QUERIES);
+    for (int i = 0; i < RAY_QUERIES; i++)
+    {
+        origins[i] = glm::vec3(position(random), position(random), position(random));
+        directions[i] = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.001f));
+    }
+    size_t rayHits = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < RAY_QUERIES; i++)
+    {
+        int closest = DynamicBVH::NONE;
+        tree.queryRay(origins[i], directions[i], extent, [&closest](int proxy, float distance) {
+            closest = proxy;
+            return distance;
+        });
+        rayHits += closest != DynamicBVH::NONE ? 1 : 0;
+    }
+    double rayUs = millisecondsSince(start) * 1000.0 / RAY_QUERIES;
+
+    size_t boxResults = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BOX_QUERIES; i++)
+    {
+        glm::vec3 center(position(random), position(random), position(random));
+        tree.queryBox(center - glm::vec3(5.0f), center + glm::vec3(5.0f), [&boxResults](int) { boxResults++; });
+    }
+    double boxUs = millisecondsSince(start) * 1000.0 / BOX_QUERIES;
+
+    printf("%zu objects: height %d (log2 %.1f)\n", count, tree.height(), std::log2((double)count));
+    printf("  build          %10.3f ms\n", buildMs);
+    printf("  update         %10.3f ms per frame for %zu moving objects, %zu refits, %zu reinserts\n", updateMs,
+           (count + 9) / 10, tree.stats().refits, tree.stats().reinserts);
+    printf("  frustum        %10.3f ms per query, %zu visible; flat sphere test %.3f ms, %zu visible\n", frustumMs,
+           treeVisible, flatMs, flatVisible);
+    printf("  ray            %10.3f us per ray, %zu of %d hit\n", rayUs, rayHits, RAY_QUERIES);
+    printf("  box            %10.3f us per query, %.1f objects each\n", boxUs, (double)boxResults / BOX_QUERIES);
+}
+
+int main()
+{
+    for (size_t count : { (size_t)1000, (size_t)100000 })
+        run(count);
+    return 0;
+}
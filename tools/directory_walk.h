@@ -0,0 +1,48 @@
+#ifndef TOOLS_DIRECTORY_WALK_H
+#define TOOLS_DIRECTORY_WALK_H
+
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// collects regular files below directory (recursively) that accept() approves, sorted by path
+template<typename Filter>
+void listFiles(const std::string &directory, Filter accept, std::vector<std::string> &files)
+{
+    DIR *dir = opendir(directory.c_str());
+    if (!dir)
+        return;
+    size_t first = files.size();
+    while (dirent *entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        std::string path = directory + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+            listFiles(path, accept, files);
+        else if (S_ISREG(st.st_mode) && accept(path))
+            files.push_back(path);
+    }
+    closedir(dir);
+    std::sort(files.begin() + first, files.end());
+}
+
+// lower-case extension including the dot, empty if there is none
+inline std::string extensionOf(const std::string &path)
+{
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return "";
+    std::string extension = path.substr(dot);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension;
+}
+#endif
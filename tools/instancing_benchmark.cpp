@@ -0,0 +1,127 @@
+// Instanced rendering benchmark: draws 1, 100 and 10000 copies of a scene model once with a Model::Draw per copy
+// and once with a single Model::DrawInstanced, and reports draw calls, CPU submission time and GPU time of both.
+// Both paths use the application's lighting shader with every light evaluated.
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model.h>
+
+#include "benchmark_context.h"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const int WARMUP_FRAMES = 3;
+static const int MEASURED_FRAMES = 20;
+
+int main()
+{
+    BenchmarkContext context(800, 600);
+    GLFWwindow *window = context.window();
+    if (!window)
+        return 1;
+    GLState::instance().setDepthTest(true);
+
+    MeshOptions options;
+    options.packVertices = true;
+    Model model(FileSystem::getPath("resources/objects/pomorandza/10195_Orange-L2.obj"), false, options);
+    model.SetShaderTextureNamePrefix("material.");
+    while (TextureLoader::instance().pendingCount() > 0)
+        TextureLoader::instance().pump(16);
+
+    std::string vertexPath = FileSystem::getPath("resources/shaders/2.model_lighting.vs");
+    std::string fragmentPath = FileSystem::getPath("resources/shaders/2.model_lighting.fs");
+    LightingFeatures features;
+    features.pointLights = LightingFeatures::MAX_POINT_LIGHTS;
+    features.spotLight = true;
+    Shader single(vertexPath.c_str(), fragmentPath.c_str(), nullptr, false, features.defines());
+    features.instanced = true;
+    Shader instanced(vertexPath.c_str(), fragmentPath.c_str(), nullptr, false, features.defines());
+    UniformHandle modelUniform = single.uniform("model");
+
+    LightsBlock lights = {};
+    for (int i = 0; i < LightsBlock::POINT_LIGHTS; i++)
+    {
+        lights.pointLights[i].position = glm::vec3(10.0f * (i - 1), 10.0f, 10.0f);
+        lights.pointLights[i].ambient = glm::vec3(0.1f);
+        lights.pointLights[i].diffuse = glm::vec3(0.6f);
+        lights.pointLights[i].specular = glm::vec3(1.0f);
+        lights.pointLights[i].constant = 1.0f;
+    }
+    lights.spotLight.direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    lights.spotLight.diffuse = lights.spotLight.specular = glm::vec3(1.0f);
+    lights.spotLight.cutOff = std::cos(glm::radians(12.5f));
+    lights.spotLight.outerCutOff = std::cos(glm::radians(17.5f));
+    UniformBuffer<LightsBlock> lightsBuffer(UniformBlocks::LIGHTS);
+    lightsBuffer.update(lights);
+    UniformBuffer<CameraBlock> cameraBuffer(UniformBlocks::CAMERA);
+
+    // one copy per cell of a square grid, scaled to fill its cell
+    glm::vec3 center;
+    float radius;
+    model.BoundingSphere(glm::mat4(1.0f), center, radius);
+    size_t ranges = 0;
+    for (const Mesh &mesh : model.meshes)
+        ranges += mesh.indexRanges.size();
+
+    printf("%10s | %12s %10s %10s | %12s %10s %10s\n", "instances", "draw calls", "CPU ms", "GPU ms", "draw calls",
+           "CPU ms", "GPU ms");
+    printf("%10s | %34s | %34s\n", "", "Model::Draw per copy", "Model::DrawInstanced");
+    BenchmarkTimer timer;
+    for (size_t count : { (size_t)1, (size_t)100, (size_t)10000 })
+    {
+        int side = (int)std::ceil(std::sqrt((double)count));
+        std::vector<glm::mat4> transforms(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            glm::vec3 cell(2.0f * (float)(i % side) - side + 1.0f, 2.0f * (float)(i / side) - side + 1.0f, 0.0f);
+            transforms[i] = glm::translate(glm::mat4(1.0f), cell);
+            transforms[i] = glm::scale(transforms[i], glm::vec3(0.9f / radius));
+            transforms[i] = glm::translate(transforms[i], -center);
+        }
+        CameraBlock camera;
+        camera.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 10.0f * side + 10.0f);
+        camera.viewPosition = glm::vec3(0.0f, 0.0f, 2.5f * side + 2.0f);
+        camera.view = glm::lookAt(camera.viewPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        camera.padding = 0.0f;
+        cameraBuffer.update(camera);
+
+        double loopCpu = 0.0, loopGpu = 0.0, instancedCpu = 0.0, instancedGpu = 0.0;
+        for (int frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; frame++)
+        {
+            bool measured = frame >= WARMUP_FRAMES;
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            timer.begin();
+            single.use();
+            for (size_t i = 0; i < count; i++)
+            {
+                single.setMat4(modelUniform, transforms[i]);
+                model.Draw(single);
+            }
+            double cpu = timer.end();
+            if (measured)
+            {
+                loopCpu += cpu;
+                loopGpu += timer.gpuMs();
+            }
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            timer.begin();
+            instanced.use();
+            model.DrawInstanced(instanced, transforms.data(), count);
+            cpu = timer.end();
+            if (measured)
+            {
+                instancedCpu += cpu;
+                instancedGpu += timer.gpuMs();
+            }
+            glfwSwapBuffers(window);
+        }
+        printf("%10zu | %12zu %10.3f %10.3f | %12zu %10.3f %10.3f\n", count, ranges * count, loopCpu / MEASURED_FRAMES,
+               loopGpu / MEASURED_FRAMES, ranges, instancedCpu / MEASURED_FRAMES, instancedGpu / MEASURED_FRAMES);
+    }
+
+    return 0;
+}
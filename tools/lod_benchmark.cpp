@@ -0,0 +1,144 @@
+// Level of detail benchmark: a 10x10 field of benches (the authored HighRes/LowRes pair) and of oranges (levels
+// the MeshSimplifier generates at 1/2, 1/4 and 1/8 of the triangles) while the camera dollies from the front row
+// to far behind the last one, wobbling a little as a hand-held camera would. Each field is drawn at full detail,
+// with levels picked from screen size without hysteresis and with the default hysteresis. Reports triangles and
+// GPU time per frame and how often objects switched level. Runs headless, llvmpipe included.
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model_lod.h>
+#include <learnopengl/shader_manager.h>
+
+#include "benchmark_context.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static const int FRAMES = 300;
+static const int GRID = 10;
+static const float VIEWPORT_HEIGHT = 600.0f;
+
+struct Scene {
+    const char *name;
+    ModelLOD *lod;
+    float spacing;  // between objects, in object radii
+};
+
+static void run(const Scene &scene, ShaderPermutations &lighting, const LightingFeatures &features,
+                UniformBuffer<CameraBlock> &cameraBuffer, GLFWwindow *window)
+{
+    ModelLOD &lod = *scene.lod;
+    glm::vec3 center;
+    float radius;
+    lod.Level(0).BoundingSphere(glm::mat4(1.0f), center, radius);
+    // every object scaled to radius 1, the field reaching away from the camera along -z
+    float scale = 1.0f / radius;
+    std::vector<glm::mat4> transforms;
+    for (int i = 0; i < GRID * GRID; i++)
+    {
+        glm::vec3 position(scene.spacing * (i % GRID - (GRID - 1) * 0.5f), 0.0f, -scene.spacing * (i / GRID));
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+        transform = glm::scale(transform, glm::vec3(scale));
+        transforms.push_back(glm::translate(transform, -center));
+    }
+    float depth = scene.spacing * GRID;
+
+    CameraBlock camera;
+    camera.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 4.0f * depth);
+    camera.padding = 0.0f;
+
+    printf("%s: %d levels,", scene.name, lod.LevelCount());
+    for (int level = 0; level < lod.LevelCount(); level++)
+        printf(" %zu", lod.Level(level).TriangleCount());
+    printf(" triangles\n");
+    printf("  %-22s | %12s %12s %10s\n", "", "triangles", "switches", "GPU ms");
+
+    BenchmarkTimer timer;
+    const char *modes[] = { "full detail", "LOD, no hysteresis", "LOD, hysteresis" };
+    for (int mode = 0; mode < 3; mode++)
+    {
+        lod.hysteresis = mode == 2 ? ModelLOD::DEFAULT_HYSTERESIS : 0.0f;
+        std::vector<int> current(transforms.size(), -1);
+        size_t triangles = 0;
+        unsigned int switches = 0;
+        double gpuMs = 0.0;
+        for (int frame = 0; frame < FRAMES; frame++)
+        {
+            // from just in front of the first row to as far behind it as the field is deep, with a wobble
+            float t = (float)frame / (FRAMES - 1);
+            float wobble = 0.03f * depth * std::sin(frame * 0.9f);
+            camera.viewPosition = glm::vec3(0.0f, 0.5f * scene.spacing, 2.0f + t * 2.0f * depth + wobble);
+            camera.view = glm::lookAt(camera.viewPosition, glm::vec3(0.0f, 0.0f, -depth * 0.5f), glm::vec3(0.0f, 1.0f, 0.0f));
+            cameraBuffer.update(camera);
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            timer.begin();
+            for (size_t i = 0; i < transforms.size(); i++)
+            {
+                int level = 0;
+                if (mode > 0)
+                {
+                    glm::vec3 objectCenter = glm::vec3(transforms[i] * glm::vec4(center, 1.0f));
+                    level = lod.SelectLevel(ModelLOD::ScreenSize(objectCenter, 1.0f, camera.viewPosition,
+                                                                 camera.projection, VIEWPORT_HEIGHT), current[i]);
+                    if (current[i] >= 0 && level != current[i])
+                        switches++;
+                    current[i] = level;
+                }
+                lod.Level(level).Draw(lighting, features, transforms[i]);
+                triangles += lod.Level(level).TriangleCount();
+            }
+            timer.end();
+            gpuMs += timer.gpuMs();
+            glfwSwapBuffers(window);
+        }
+        printf("  %-22s | %12zu %12u %10.3f\n", modes[mode], triangles / FRAMES, switches, gpuMs / FRAMES);
+    }
+}
+
+int main()
+{
+    BenchmarkContext context(800, 600);
+    GLFWwindow *window = context.window();
+    if (!window)
+        return 1;
+    GLState::instance().setDepthTest(true);
+
+    MeshOptions options;
+    options.packVertices = true;
+    ThreadPool pool;
+    std::future<vector<ModelData>> benchData = ModelLOD::LoadAsync(pool, {
+        FileSystem::getPath("resources/objects/klupa/Bench_HighRes.obj"),
+        FileSystem::getPath("resources/objects/klupa/Bench_LowRes.obj") }, options);
+    std::future<vector<ModelData>> orangeData = ModelLOD::LoadAsync(pool,
+        FileSystem::getPath("resources/objects/pomorandza/10195_Orange-L2.obj"), { 0.5f, 0.25f, 0.125f }, options);
+    ModelLOD bench(benchData.get(), false, options);
+    ModelLOD orange(orangeData.get(), false, options);
+    for (ModelLOD *lod : { &bench, &orange })
+        lod->SetShaderTextureNamePrefix("material.");
+    while (TextureLoader::instance().pendingCount() > 0)
+        TextureLoader::instance().pump(16);
+
+    ShaderManager shaders;
+    ShaderPermutations lighting(shaders, FileSystem::getPath("resources/shaders/2.model_lighting.vs"),
+                                FileSystem::getPath("resources/shaders/2.model_lighting.fs"));
+    LightingFeatures features;
+    features.pointLights = 1;
+    features.pointLightIndex[0] = 0;
+
+    LightsBlock lights = {};
+    lights.pointLights[0].position = glm::vec3(0.0f, 50.0f, 20.0f);
+    lights.pointLights[0].ambient = glm::vec3(0.2f);
+    lights.pointLights[0].diffuse = glm::vec3(0.8f);
+    lights.pointLights[0].specular = glm::vec3(1.0f);
+    lights.pointLights[0].constant = 1.0f;
+    UniformBuffer<LightsBlock> lightsBuffer(UniformBlocks::LIGHTS);
+    lightsBuffer.update(lights);
+    UniformBuffer<CameraBlock> cameraBuffer(UniformBlocks::CAMERA);
+
+    Scene scenes[] = { { "bench (authored levels)", &bench, 3.0f }, { "orange (generated levels)", &orange, 3.0f } };
+    for (const Scene &scene : scenes)
+        run(scene, lighting, features, cameraBuffer, window);
+
+    return 0;
+}
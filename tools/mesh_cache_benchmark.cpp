@@ -0,0 +1,74 @@
+// Start-up benchmark for the binary mesh cache: for every model under resources/objects it times a cold Assimp
+// import plus the import-time mesh optimization (the path Model takes without a cache) against loading the same
+// meshes from the cache.
+// Writes/refreshes the caches as a side effect.
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model.h>
+
+#include "directory_walk.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    Assimp::Importer importer;
+    std::vector<std::string> models;
+    listFiles(FileSystem::getPath("resources/objects"), [&importer](const std::string &path) {
+        return importer.IsExtensionSupported(extensionOf(path).c_str());
+    }, models);
+
+    // the same processing the application applies, so the caches written here stay valid for it
+    MeshOptions options;
+    unsigned int processing = Model::processingFlags(options);
+
+    double totalCold = 0.0, totalCached = 0.0;
+    printf("%-70s %10s %10s %10s %8s\n", "model", "vertices", "import ms", "cache ms", "speedup");
+    for (const std::string &path : models)
+    {
+        std::vector<MeshData> meshes;
+        auto start = std::chrono::steady_clock::now();
+        if (!Model::ImportMeshData(path, meshes))
+            continue;
+        Model::ProcessMeshData(path, meshes, options);
+        double cold = millisecondsSince(start);
+        if (!MeshCache::store(path, Model::IMPORT_FLAGS, processing, meshes))
+        {
+            printf("%-70s could not write cache\n", path.c_str());
+            continue;
+        }
+
+        // best of a few runs, the first one may still be paying for the page cache
+        double cached = 0.0;
+        for (int run = 0; run < 3; run++)
+        {
+            std::vector<MeshData> cachedMeshes;
+            start = std::chrono::steady_clock::now();
+            bool loaded = MeshCache::load(path, Model::IMPORT_FLAGS, processing, cachedMeshes);
+            double elapsed = millisecondsSince(start);
+            if (!loaded)
+            {
+                printf("%-70s cache rejected\n", path.c_str());
+                break;
+            }
+            cached = run == 0 ? elapsed : std::min(cached, elapsed);
+        }
+
+        size_t vertices = 0;
+        for (const MeshData &mesh : meshes)
+            vertices += mesh.vertices.size();
+        totalCold += cold;
+        totalCached += cached;
+        printf("%-70s %10zu %10.2f %10.2f %7.1fx\n", path.c_str(), vertices, cold, cached, cached > 0.0 ? cold / cached : 0.0);
+    }
+    printf("%-70s %10s %10.2f %10.2f %7.1fx\n", "total", "", totalCold, totalCached, totalCached > 0.0 ? totalCold / totalCached : 0.0);
+    return 0;
+}
@@ -0,0 +1,247 @@
+#ifndef TOOLS_MIP_FILTER_H
+#define TOOLS_MIP_FILTER_H
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// Offline mip chain generation for the texture baker. Each level is produced from the previous one with a
+// separable resampling kernel; colour channels are filtered in linear light unless the image holds data
+// (normal, specular or height maps), alpha is always filtered as stored and colour is weighted by it.
+enum MipKernel {
+    MIP_BOX,     // 2x2 average, what glGenerateMipmap does on most drivers
+    MIP_TENT,    // triangle, radius 1
+    MIP_KAISER,  // Kaiser-windowed sinc, radius 3, sharper without much ringing
+    MIP_LANCZOS  // Lanczos-3, sharpest, may ring on hard edges
+};
+
+inline bool parseMipKernel(const std::string &name, MipKernel &kernel)
+{
+    if (name == "box") kernel = MIP_BOX;
+    else if (name == "tent") kernel = MIP_TENT;
+    else if (name == "kaiser") kernel = MIP_KAISER;
+    else if (name == "lanczos") kernel = MIP_LANCZOS;
+    else return false;
+    return true;
+}
+
+// one level as floats, channels interleaved
+struct MipImage {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::vector<float> texels;
+};
+
+class MipChainBuilder
+{
+public:
+    MipChainBuilder(MipKernel kernel, bool srgb, bool wrap) : kernel(kernel), srgb(srgb), wrap(wrap) {}
+
+    // all levels from full size down to 1x1, as 8-bit texels
+    std::vector<std::vector<unsigned char>> build(const unsigned char *pixels, int width, int height, int channels,
+                                                  std::vector<std::pair<int, int>> &sizes) const
+    {
+        MipImage level;
+        level.width = width;
+        level.height = height;
+        level.channels = channels;
+        level.texels.resize((size_t)width * height * channels);
+        for (size_t i = 0; i < level.texels.size(); i++)
+        {
+            float v = pixels[i] / 255.0f;
+            level.texels[i] = isColour((int)(i % channels), channels) ? srgbToLinear(v) : v;
+        }
+        // colour is filtered premultiplied so fully transparent texels don't bleed into their neighbours
+        if (hasAlpha(channels))
+            forEachTexel(level, [](float *texel, int channels) {
+                for (int c = 0; c < channels - 1; c++)
+                    texel[c] *= texel[channels - 1];
+            });
+
+        std::vector<std::vector<unsigned char>> levels;
+        sizes.clear();
+        for (;;)
+        {
+            levels.push_back(quantize(level));
+            sizes.push_back(std::make_pair(level.width, level.height));
+            if (level.width == 1 && level.height == 1)
+                break;
+            MipImage horizontal = resample(level, std::max(1, level.width / 2), level.height, true);
+            level = resample(horizontal, horizontal.width, std::max(1, level.height / 2), false);
+        }
+        return levels;
+    }
+
+private:
+    MipKernel kernel;
+    bool srgb;
+    bool wrap;
+
+    // the filter's support radius, in destination texels
+    float radius() const
+    {
+        switch (kernel)
+        {
+            case MIP_BOX: return 0.5f;
+            case MIP_TENT: return 1.0f;
+            default: return 3.0f;
+        }
+    }
+
+    static float sinc(float x)
+    {
+        if (std::fabs(x) < 1e-5f)
+            return 1.0f;
+        x *= 3.14159265f;
+        return std::sin(x) / x;
+    }
+
+    // zeroth order modified Bessel function of the first kind, for the Kaiser window
+    static float besselI0(float x)
+    {
+        float sum = 1.0f, term = 1.0f;
+        for (int k = 1; k < 20; k++)
+        {
+            term *= (x / (2.0f * k)) * (x / (2.0f * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    float weight(float x) const
+    {
+        x = std::fabs(x);
+        switch (kernel)
+        {
+            case MIP_BOX:
+                return x <= 0.5f ? 1.0f : 0.0f;
+            case MIP_TENT:
+                return std::max(0.0f, 1.0f - x);
+            case MIP_KAISER:
+            {
+                if (x >= 3.0f)
+                    return 0.0f;
+                const float alpha = 4.0f;
+                float t = x / 3.0f;
+                return sinc(x) * besselI0(alpha * std::sqrt(1.0f - t * t)) / besselI0(alpha);
+            }
+            case MIP_LANCZOS:
+                return x < 3.0f ? sinc(x) * sinc(x / 3.0f) : 0.0f;
+        }
+        return 0.0f;
+    }
+
+    bool isColour(int channel, int channels) const
+    {
+        // grey+alpha and RGBA keep alpha linear
+        return srgb && !(hasAlpha(channels) && channel == channels - 1);
+    }
+
+    static bool hasAlpha(int channels)
+    {
+        return channels == 2 || channels == 4;
+    }
+
+    template<typename F>
+    static void forEachTexel(MipImage &image, F f)
+    {
+        for (size_t i = 0; i < image.texels.size(); i += image.channels)
+            f(&image.texels[i], image.channels);
+    }
+
+    std::vector<unsigned char> quantize(MipImage image) const
+    {
+        if (hasAlpha(image.channels))
+            forEachTexel(image, [](float *texel, int channels) {
+                float alpha = texel[channels - 1];
+                for (int c = 0; c < channels - 1; c++)
+                    texel[c] = alpha > 0.0f ? texel[c] / alpha : 0.0f;
+            });
+
+        std::vector<unsigned char> bytes(image.texels.size());
+        for (size_t i = 0; i < bytes.size(); i++)
+        {
+            float v = image.texels[i];
+            if (isColour((int)(i % image.channels), image.channels))
+                v = linearToSrgb(v);
+            bytes[i] = (unsigned char)std::lround(std::min(1.0f, std::max(0.0f, v)) * 255.0f);
+        }
+        return bytes;
+    }
+
+    static float srgbToLinear(float v)
+    {
+        return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+    }
+
+    static float linearToSrgb(float v)
+    {
+        v = std::min(1.0f, std::max(0.0f, v));
+        return v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+    }
+
+    int sourceIndex(int index, int size) const
+    {
+        if (wrap)
+            return ((index % size) + size) % size;
+        return std::min(size - 1, std::max(0, index));
+    }
+
+    // resamples one axis; horizontal selects x, the other axis is left untouched
+    MipImage resample(const MipImage &source, int width, int height, bool horizontal) const
+    {
+        MipImage result;
+        result.width = width;
+        result.height = height;
+        result.channels = source.channels;
+        result.texels.assign((size_t)width * height * source.channels, 0.0f);
+
+        int sourceSize = horizontal ? source.width : source.height;
+        int targetSize = horizontal ? width : height;
+        if (sourceSize == targetSize)
+            return source;
+        float scale = (float)sourceSize / (float)targetSize;
+        float support = radius() * scale;
+
+        // weights only depend on the destination coordinate, compute them once per row/column
+        std::vector<std::vector<std::pair<int, float>>> taps(targetSize);
+        for (int i = 0; i < targetSize; i++)
+        {
+            float center = (i + 0.5f) * scale;
+            int first = (int)std::floor(center - support);
+            int last = (int)std::ceil(center + support);
+            float total = 0.0f;
+            for (int j = first; j <= last; j++)
+            {
+                float w = weight((j + 0.5f - center) / scale);
+                if (w == 0.0f)
+                    continue;
+                taps[i].push_back(std::make_pair(sourceIndex(j, sourceSize), w));
+                total += w;
+            }
+            for (auto &tap : taps[i])
+                tap.second /= total;
+        }
+
+        int channels = source.channels;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                float *out = &result.texels[((size_t)y * width + x) * channels];
+                for (const auto &tap : taps[horizontal ? x : y])
+                {
+                    int sx = horizontal ? tap.first : x;
+                    int sy = horizontal ? y : tap.first;
+                    const float *in = &source.texels[((size_t)sy * source.width + sx) * channels];
+                    for (int c = 0; c < channels; c++)
+                        out[c] += in[c] * tap.second;
+                }
+            }
+        }
+        return result;
+    }
+};
+#endif
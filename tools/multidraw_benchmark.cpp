@@ -0,0 +1,199 @@
+// Static mesh submission benchmark: the application's scene and a synthetic scene of 5000 small meshes, each
+// submitted through the RenderQueue one draw per mesh, then from a MeshArena with one glDrawElementsBaseVertex per
+// mesh and with one glMultiDrawElementsIndirect per batch where the context supports it. Reports the GL draw
+// calls, the CPU time of submitting and executing a frame's draws, and the GPU time.
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader_manager.h>
+
+#include "benchmark_context.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const int WARMUP_FRAMES = 5;
+static const int MEASURED_FRAMES = 50;
+static const int SYNTHETIC_MESHES = 5000;
+
+struct Placed {
+    Model *model;
+    glm::mat4 transform;
+};
+
+// SYNTHETIC_MESHES cubes of half a unit on a 100-wide grid in the xy plane, each a separate mesh
+static ModelData syntheticScene()
+{
+    static const float corners[8][3] = {
+        { -0.25f, -0.25f, -0.25f }, { 0.25f, -0.25f, -0.25f }, { 0.25f, 0.25f, -0.25f }, { -0.25f, 0.25f, -0.25f },
+        { -0.25f, -0.25f, 0.25f }, { 0.25f, -0.25f, 0.25f }, { 0.25f, 0.25f, 0.25f }, { -0.25f, 0.25f, 0.25f }
+    };
+    static const unsigned int faces[36] = {
+        0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4, 3, 6, 2, 3, 7, 6, 0, 4, 7, 0, 7, 3, 1, 2, 6, 1, 6, 5
+    };
+    ModelData data;
+    data.path = "synthetic";
+    data.loaded = true;
+    data.meshes.resize(SYNTHETIC_MESHES);
+    for (int i = 0; i < SYNTHETIC_MESHES; i++)
+    {
+        glm::vec3 cell((float)(i % 100) - 49.5f, (float)(i / 100) - 24.5f, 0.0f);
+        for (const float *corner : corners)
+        {
+            Vertex vertex;
+            vertex.Position = cell + glm::vec3(corner[0], corner[1], corner[2]);
+            vertex.Normal = glm::normalize(glm::vec3(corner[0], corner[1], corner[2]));
+            vertex.TexCoords = glm::vec2(0.0f);
+            vertex.Tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+            vertex.Bitangent = glm::vec3(0.0f, 1.0f, 0.0f);
+            data.meshes[i].vertices.push_back(vertex);
+        }
+        data.meshes[i].indices.assign(faces, faces + 36);
+    }
+    return data;
+}
+
+int main()
+{
+    BenchmarkContext context(800, 600);
+    GLFWwindow *window = context.window();
+    if (!window)
+        return 1;
+    GLState::instance().setDepthTest(true);
+
+    // the application's models and placements, see main.cpp
+    MeshOptions options;
+    options.packVertices = true;
+    options.keepCPUData = false;
+    Model pas(FileSystem::getPath("resources/objects/pas/13463_Australian_Cattle_Dog_v3.obj"), false, options);
+    Model lopta(FileSystem::getPath("resources/objects/ball/10536_soccerball_V1_iterations-2.obj"), false, options);
+    Model kutija(FileSystem::getPath("resources/objects/kutija/14028_Wood_Fruit_Crate_v1_l1.obj"), false, options);
+    Model pomorandza(FileSystem::getPath("resources/objects/pomorandza/10195_Orange-L2.obj"), false, options);
+    Model synthetic(syntheticScene(), false, options);
+    pas.normalMapping = false;
+    for (Model *model : { &pas, &lopta, &kutija, &pomorandza, &synthetic })
+        model->SetShaderTextureNamePrefix("material.");
+    while (TextureLoader::instance().pendingCount() > 0)
+        TextureLoader::instance().pump(16);
+
+    glm::mat4 transform;
+    std::vector<Placed> scene;
+    transform = glm::translate(glm::mat4(1.0f), glm::vec3(12.0f, -8.0f, -5.8f));
+    transform = glm::rotate(transform, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    scene.push_back({ &pas, glm::scale(transform, glm::vec3(0.19f)) });
+    transform = glm::translate(glm::mat4(1.0f), glm::vec3(6.0f, -7.0f, 6.8f));
+    scene.push_back({ &lopta, glm::scale(transform, glm::vec3(0.1f)) });
+    transform = glm::translate(glm::mat4(1.0f), glm::vec3(14.0f, -5.0f, 11.8f));
+    transform = glm::rotate(transform, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    transform = glm::rotate(transform, glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    scene.push_back({ &kutija, glm::scale(transform, glm::vec3(0.03f)) });
+    transform = glm::translate(glm::mat4(1.0f), glm::vec3(12.5f, -5.2f, 11.8f));
+    transform = glm::rotate(transform, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    transform = glm::rotate(transform, glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    scene.push_back({ &pomorandza, glm::scale(transform, glm::vec3(0.03f)) });
+    std::vector<Placed> syntheticPlaced = { { &synthetic, glm::mat4(1.0f) } };
+
+    MeshArena arena;
+    std::vector<Mesh*> meshes;
+    for (Model *model : { &pas, &lopta, &kutija, &pomorandza, &synthetic })
+        model->CollectMeshes(meshes);
+    // the per-mesh path draws the same meshes from their own buffers
+    arena.build(meshes, true);
+    bool multiDrawSupported = arena.setMultiDraw(true);
+
+    ShaderManager shaders;
+    ShaderPermutations lighting(shaders, FileSystem::getPath("resources/shaders/2.model_lighting.vs"),
+                                FileSystem::getPath("resources/shaders/2.model_lighting.fs"));
+    LightingFeatures features;
+    features.pointLights = LightingFeatures::MAX_POINT_LIGHTS;
+    for (int i = 0; i < features.pointLights; i++)
+        features.pointLightIndex[i] = i;
+    features.spotLight = true;
+
+    LightsBlock lights = {};
+    for (int i = 0; i < LightsBlock::POINT_LIGHTS; i++)
+    {
+        lights.pointLights[i].position = glm::vec3(10.0f * (i - 1), 10.0f, 10.0f);
+        lights.pointLights[i].ambient = glm::vec3(0.1f);
+        lights.pointLights[i].diffuse = glm::vec3(0.6f);
+        lights.pointLights[i].specular = glm::vec3(1.0f);
+        lights.pointLights[i].constant = 1.0f;
+    }
+    lights.spotLight.direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    lights.spotLight.diffuse = lights.spotLight.specular = glm::vec3(1.0f);
+    lights.spotLight.cutOff = std::cos(glm::radians(12.5f));
+    lights.spotLight.outerCutOff = std::cos(glm::radians(17.5f));
+    UniformBuffer<LightsBlock> lightsBuffer(UniformBlocks::LIGHTS);
+    lightsBuffer.update(lights);
+    UniformBuffer<CameraBlock> cameraBuffer(UniformBlocks::CAMERA);
+
+    struct Scene {
+        const char *name;
+        const std::vector<Placed> *placed;
+        glm::vec3 eye, target;
+    };
+    const Scene scenes[] = {
+        { "application scene", &scene, glm::vec3(-5.0f, 5.0f, 25.0f), glm::vec3(10.0f, -5.0f, 3.0f) },
+        { "5000 meshes", &syntheticPlaced, glm::vec3(0.0f, 0.0f, 90.0f), glm::vec3(0.0f) },
+    };
+    enum Path { PER_MESH, ARENA_PER_DRAW, ARENA_MULTI_DRAW };
+    const char *pathNames[] = { "RenderQueue, per mesh", "arena, per draw", "arena, multi-draw indirect" };
+
+    printf("%-18s | %-27s | %8s %8s %10s %10s\n", "scene", "submission", "batches", "calls", "CPU ms", "GPU ms");
+    RenderQueue queue;
+    BenchmarkTimer timer;
+    for (const Scene &current : scenes)
+    {
+        CameraBlock camera;
+        camera.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 200.0f);
+        camera.view = glm::lookAt(current.eye, current.target, glm::vec3(0.0f, 1.0f, 0.0f));
+        camera.viewPosition = current.eye;
+        camera.padding = 0.0f;
+        cameraBuffer.update(camera);
+
+        for (int path = PER_MESH; path <= ARENA_MULTI_DRAW; path++)
+        {
+            if (path == ARENA_MULTI_DRAW && !multiDrawSupported)
+            {
+                printf("%-18s | %-27s | not supported by this context\n", current.name, pathNames[path]);
+                continue;
+            }
+            if (path != PER_MESH)
+                arena.setMultiDraw(path == ARENA_MULTI_DRAW);
+
+            double cpuMs = 0.0, gpuMs = 0.0;
+            unsigned int batches = 0, calls = 0;
+            for (int frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; frame++)
+            {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                timer.begin();
+                queue.begin(200.0f);
+                arena.begin();
+                for (const Placed &placed : *current.placed)
+                {
+                    float depth = glm::length(glm::vec3(placed.transform[3]) - current.eye);
+                    if (path == PER_MESH)
+                        placed.model->Submit(queue, lighting, features, placed.transform, depth);
+                    else
+                        placed.model->Submit(queue, arena, lighting, features, placed.transform, depth);
+                }
+                MeshArena::FrameStats arenaStats = arena.flush(queue);
+                RenderQueue::FrameStats queueStats = queue.execute();
+                double cpu = timer.end();
+                if (frame >= WARMUP_FRAMES)
+                {
+                    cpuMs += cpu;
+                    gpuMs += timer.gpuMs();
+                }
+                batches = path == PER_MESH ? queueStats.draws : arenaStats.batches;
+                calls = path == PER_MESH ? queueStats.draws : arenaStats.calls;
+                glfwSwapBuffers(window);
+            }
+            printf("%-18s | %-27s | %8u %8u %10.3f %10.3f\n", current.name, pathNames[path], batches, calls,
+                   cpuMs / MEASURED_FRAMES, gpuMs / MEASURED_FRAMES);
+        }
+    }
+
+    return 0;
+}
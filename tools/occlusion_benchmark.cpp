@@ -0,0 +1,163 @@
+// Occlusion culling benchmark: a wall in front of a 20x20 grid of oranges, part of the grid reaching past the
+// wall's edges. The grid is drawn once with every orange and once with those the OcclusionCuller did not find
+// hidden behind the wall. Reports the oranges drawn, how many frames the first results took, and CPU and GPU
+// time per frame including the culler's own passes. Runs headless, llvmpipe included.
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model.h>
+#include <learnopengl/occlusion_culler.h>
+#include <learnopengl/shader_manager.h>
+
+#include "benchmark_context.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static const int WARMUP_FRAMES = 5;
+static const int MEASURED_FRAMES = 50;
+static const int GRID = 20;
+
+// a unit cube around the origin as a one-mesh model
+static ModelData boxData()
+{
+    static const float corners[8][3] = {
+        { -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, -0.5f }, { -0.5f, 0.5f, -0.5f },
+        { -0.5f, -0.5f, 0.5f }, { 0.5f, -0.5f, 0.5f }, { 0.5f, 0.5f, 0.5f }, { -0.5f, 0.5f, 0.5f }
+    };
+    static const unsigned int faces[36] = {
+        0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4, 3, 6, 2, 3, 7, 6, 0, 4, 7, 0, 7, 3, 1, 2, 6, 1, 6, 5
+    };
+    ModelData data;
+    data.path = "wall";
+    data.loaded = true;
+    data.meshes.resize(1);
+    for (const float *corner : corners)
+    {
+        Vertex vertex;
+        vertex.Position = glm::vec3(corner[0], corner[1], corner[2]);
+        vertex.Normal = glm::normalize(vertex.Position);
+        vertex.TexCoords = glm::vec2(0.0f);
+        vertex.Tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+        vertex.Bitangent = glm::vec3(0.0f, 1.0f, 0.0f);
+        data.meshes[0].vertices.push_back(vertex);
+    }
+    data.meshes[0].indices.assign(faces, faces + 36);
+    return data;
+}
+
+int main()
+{
+    BenchmarkContext context(800, 600);
+    GLFWwindow *window = context.window();
+    if (!window)
+        return 1;
+    GLState::instance().setDepthTest(true);
+
+    MeshOptions options;
+    options.packVertices = true;
+    Model orange(FileSystem::getPath("resources/objects/pomorandza/10195_Orange-L2.obj"), false, options);
+    Model wall(boxData(), false, options);
+    for (Model *model : { &orange, &wall })
+        model->SetShaderTextureNamePrefix("material.");
+    while (TextureLoader::instance().pendingCount() > 0)
+        TextureLoader::instance().pump(16);
+
+    ShaderManager shaders;
+    ShaderPermutations lighting(shaders, FileSystem::getPath("resources/shaders/2.model_lighting.vs"),
+                                FileSystem::getPath("resources/shaders/2.model_lighting.fs"));
+    OcclusionCuller occlusion(shaders, FileSystem::getPath("resources/shaders/"));
+    if (!occlusion.isAvailable())
+    {
+        printf("occlusion culling is not available in this context\n");
+        return 1;
+    }
+    LightingFeatures features;
+    features.pointLights = LightingFeatures::MAX_POINT_LIGHTS;
+    for (int i = 0; i < features.pointLights; i++)
+        features.pointLightIndex[i] = i;
+    features.spotLight = true;
+
+    LightsBlock lights = {};
+    for (int i = 0; i < LightsBlock::POINT_LIGHTS; i++)
+    {
+        lights.pointLights[i].position = glm::vec3(10.0f * (i - 1), 10.0f, 10.0f);
+        lights.pointLights[i].ambient = glm::vec3(0.1f);
+        lights.pointLights[i].diffuse = glm::vec3(0.6f);
+        lights.pointLights[i].specular = glm::vec3(1.0f);
+        lights.pointLights[i].constant = 1.0f;
+    }
+    lights.spotLight.direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    lights.spotLight.diffuse = lights.spotLight.specular = glm::vec3(1.0f);
+    lights.spotLight.cutOff = std::cos(glm::radians(12.5f));
+    lights.spotLight.outerCutOff = std::cos(glm::radians(17.5f));
+    UniformBuffer<LightsBlock> lightsBuffer(UniformBlocks::LIGHTS);
+    lightsBuffer.update(lights);
+    UniformBuffer<CameraBlock> cameraBuffer(UniformBlocks::CAMERA);
+    CameraBlock camera;
+    camera.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    camera.viewPosition = glm::vec3(0.0f, 0.0f, 30.0f);
+    camera.view = glm::lookAt(camera.viewPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    camera.padding = 0.0f;
+    cameraBuffer.update(camera);
+
+    // the wall covers the middle of the view; oranges of radius 0.8 two units apart, eight units behind it
+    glm::mat4 wallTransform = glm::scale(glm::mat4(1.0f), glm::vec3(24.0f, 14.0f, 1.0f));
+    glm::vec3 orangeCenter;
+    float orangeRadius;
+    orange.BoundingSphere(glm::mat4(1.0f), orangeCenter, orangeRadius);
+    float scale = 0.8f / orangeRadius;
+    std::vector<glm::mat4> transforms;
+    std::vector<glm::vec3> centers;
+    for (int i = 0; i < GRID * GRID; i++)
+    {
+        glm::vec3 position(2.0f * (i % GRID) - GRID + 1.0f, 2.0f * (i / GRID) - GRID + 1.0f, -8.0f);
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+        transform = glm::scale(transform, glm::vec3(scale));
+        transforms.push_back(glm::translate(transform, -orangeCenter));
+        centers.push_back(position);
+    }
+
+    printf("%-24s | %8s %8s %10s %10s\n", "", "drawn", "hidden", "CPU ms", "GPU ms");
+    BenchmarkTimer timer;
+    for (bool culling : { false, true })
+    {
+        double cpuMs = 0.0, gpuMs = 0.0;
+        unsigned int drawn = 0, hidden = 0;
+        int firstResult = -1;
+        for (int frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; frame++)
+        {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            timer.begin();
+            occlusion.begin();
+            occlusion.addOccluder(wall, wallTransform);
+            wall.Draw(lighting, features, wallTransform);
+            unsigned int frameDrawn = 0;
+            for (size_t i = 0; i < transforms.size(); i++)
+            {
+                if (culling && !occlusion.add(centers[i], 0.8f))
+                    continue;
+                orange.Draw(lighting, features, transforms[i]);
+                frameDrawn++;
+            }
+            OcclusionCuller::FrameStats stats = culling ? occlusion.render() : OcclusionCuller::FrameStats();
+            double cpu = timer.end();
+            if (culling && firstResult < 0 && stats.tested > 0)
+                firstResult = frame;
+            if (frame >= WARMUP_FRAMES)
+            {
+                cpuMs += cpu;
+                gpuMs += timer.gpuMs();
+                drawn += frameDrawn;
+                hidden += stats.occluded;
+            }
+            glfwSwapBuffers(window);
+        }
+        printf("%-24s | %8u %8u %10.3f %10.3f\n", culling ? "occlusion culling" : "everything drawn",
+               drawn / MEASURED_FRAMES, hidden / MEASURED_FRAMES, cpuMs / MEASURED_FRAMES, gpuMs / MEASURED_FRAMES);
+        if (culling)
+            printf("first results used in frame %d\n", firstResult);
+    }
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+// Offline texture baker: converts images into .rgtex containers holding the full, pre-filtered mip chain,
+// which TextureLoader uploads level by level instead of decoding the source and calling glGenerateMipmap.
+//
+// usage: texture_baker [--filter box|tent|kaiser|lanczos] [--linear] [--clamp] [--compress] [--bc5-normals] [--force]
+//                      [file or directory...]
+// without paths it bakes resources/textures and resources/objects.
+//
+// --compress stores the levels block compressed: RGB as BC1, RGBA as BC3 and grey+alpha as BC5. Single channel
+// images stay uncompressed. --bc5-normals also stores normal maps as BC5, keeping only X and Y; whatever samples
+// them has to reconstruct Z. Images with a mip level whose height is not a multiple of 4 (1280 -> ... -> 10) stay
+// uncompressed, the loader could not flip those levels block by block and would decode the source every run.
+
+#include <learnopengl/baked_texture.h>
+#include <learnopengl/filesystem.h>
+#include <stb_image.h>
+
+#include "bc_encoder.h"
+#include "directory_walk.h"
+#include "mip_filter.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct BakeOptions {
+    MipKernel kernel = MIP_KAISER;
+    bool forceLinear = false;
+    bool clamp = false;
+    bool compress = false;
+    bool bc5Normals = false;
+    bool force = false;
+};
+
+static bool isImage(const std::string &path)
+{
+    std::string extension = extensionOf(path);
+    return extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".tga" || extension == ".bmp";
+}
+
+// normal, bump, specular and similar maps hold data rather than colour and must not be filtered in linear light
+static bool holdsData(const std::string &path)
+{
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    for (char &c : name)
+        c = (char)tolower(c);
+    const char *markers[] = { "normal", "nrm", "bump", "spec", "height", "disp", "rough", "metal", "_ao", "ao." };
+    for (const char *marker : markers)
+        if (name.find(marker) != std::string::npos)
+            return true;
+    return false;
+}
+
+static bool isNormalMap(const std::string &path)
+{
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    for (char &c : name)
+        c = (char)tolower(c);
+    return name.find("normal") != std::string::npos || name.find("nrm") != std::string::npos;
+}
+
+static BakedFormat formatFor(const std::string &path, int channels, int height, const BakeOptions &options)
+{
+    if (options.compress && BakedTexture::canFlipBlockChain((uint32_t)height))
+    {
+        if (channels == 2 || (channels >= 3 && options.bc5Normals && isNormalMap(path)))
+            return BAKED_BC5;
+        if (channels == 3)
+            return BAKED_BC1;
+        if (channels == 4)
+            return BAKED_BC3;
+    }
+    return (BakedFormat)channels; // BAKED_R8..BAKED_RGBA8 match the component count
+}
+
+// root mean square error per encoded channel between a level and its compressed version, in 8-bit steps
+static double compressionError(BakedFormat format, const std::vector<unsigned char> &texels, const std::vector<unsigned char> &blocks,
+                               int width, int height, int channels)
+{
+    std::vector<unsigned char> decoded = BlockEncoder::decodeLevel(format, blocks.data(), width, height);
+    int compared = format == BAKED_BC1 ? 3 : format == BAKED_BC5 ? 2 : 4;
+    double sum = 0.0;
+    for (size_t i = 0; i < (size_t)width * height; i++)
+    {
+        unsigned char source[4];
+        BlockEncoder::expandTexel(&texels[i * channels], channels, source);
+        for (int c = 0; c < compared; c++)
+        {
+            double d = (double)decoded[i * 4 + c] - source[c];
+            sum += d * d;
+        }
+    }
+    return std::sqrt(sum / ((double)width * height * compared));
+}
+
+// the BakedTexture flags a bake of path with channels components and these options records
+static uint32_t bakeFlags(const std::string &path, int channels, int height, const BakeOptions &options)
+{
+    uint32_t flags = 0;
+    if (!options.forceLinear && !holdsData(path))
+        flags |= BakedTexture::BAKE_SRGB;
+    if (!options.clamp)
+        flags |= BakedTexture::BAKE_WRAP;
+    if (channels >= 3 && formatFor(path, channels, height, options) == BAKED_BC5)
+        flags |= BakedTexture::BAKE_NORMAL_XY;
+    return flags;
+}
+
+static bool bake(const std::string &path, const BakeOptions &options)
+{
+    // a container baked with other settings (filter, colour space, wrap mode, compression or normal encoding) is rebaked
+    BakedTexture existing;
+    int width, height, channels;
+    if (!options.force && stbi_info(path.c_str(), &width, &height, &channels) && BakedTexture::load(path, existing)
+        && existing.kernel == (uint32_t)options.kernel && existing.flags == bakeFlags(path, channels, height, options)
+        && existing.format == formatFor(path, channels, height, options))
+    {
+        printf("%-70s up to date\n", path.c_str());
+        return true;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    unsigned char *pixels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+    if (!pixels)
+    {
+        printf("%-70s failed to decode: %s\n", path.c_str(), stbi_failure_reason());
+        return false;
+    }
+
+    uint32_t flags = bakeFlags(path, channels, height, options);
+    bool srgb = (flags & BakedTexture::BAKE_SRGB) != 0;
+    MipChainBuilder builder(options.kernel, srgb, !options.clamp);
+    std::vector<std::pair<int, int>> sizes;
+    std::vector<std::vector<unsigned char>> levels = builder.build(pixels, width, height, channels, sizes);
+    stbi_image_free(pixels);
+
+    BakedTexture baked;
+    baked.format = formatFor(path, channels, height, options);
+    baked.width = (uint32_t)width;
+    baked.height = (uint32_t)height;
+    baked.kernel = (uint32_t)options.kernel;
+    baked.flags = flags;
+    double error = 0.0;
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        if (BakedTexture::isCompressed(baked.format))
+        {
+            std::vector<unsigned char> blocks = BlockEncoder::encodeLevel(baked.format, levels[i].data(), sizes[i].first, sizes[i].second, channels);
+            if (i == 0)
+                error = compressionError(baked.format, levels[i], blocks, width, height, channels);
+            levels[i].swap(blocks);
+        }
+        BakedTexture::Level level;
+        level.width = (uint32_t)sizes[i].first;
+        level.height = (uint32_t)sizes[i].second;
+        level.offset = baked.data.size();
+        level.size = levels[i].size();
+        baked.levels.push_back(level);
+        baked.data.insert(baked.data.end(), levels[i].begin(), levels[i].end());
+    }
+    if (!baked.store(path))
+    {
+        printf("%-70s failed to write %s\n", path.c_str(), BakedTexture::pathFor(path).c_str());
+        return false;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("%-70s %5dx%-5d %d ch %2zu levels %s %8.1f ms", path.c_str(), width, height, channels,
+           baked.levels.size(), srgb ? "srgb  " : "linear", ms);
+    if (BakedTexture::isCompressed(baked.format))
+        printf("  %s %6zu KiB (from %6zu KiB) rmse %.2f", BakedTexture::nameOf(baked.format), baked.data.size() / 1024,
+               (size_t)baked.uncompressedSize() / 1024, error);
+    else if (options.compress && channels != 1)
+        printf("  uncompressed, mip heights not all multiples of 4");
+    printf("\n");
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    BakeOptions options;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--filter" && i + 1 < argc)
+        {
+            if (!parseMipKernel(argv[++i], options.kernel))
+            {
+                fprintf(stderr, "unknown filter %s, expected box, tent, kaiser or lanczos\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (argument == "--linear")
+            options.forceLinear = true;
+        else if (argument == "--clamp")
+            options.clamp = true;
+        else if (argument == "--compress")
+            options.compress = true;
+        else if (argument == "--bc5-normals")
+            options.bc5Normals = true;
+        else if (argument == "--force")
+            options.force = true;
+        else if (argument.compare(0, 2, "--") == 0)
+        {
+            fprintf(stderr, "usage: %s [--filter box|tent|kaiser|lanczos] [--linear] [--clamp] [--compress] [--bc5-normals] [--force] "
+                    "[file or directory...]\n", argv[0]);
+            return 1;
+        }
+        else
+            inputs.push_back(argument);
+    }
+    if (inputs.empty())
+    {
+        inputs.push_back(FileSystem::getPath("resources/textures"));
+        inputs.push_back(FileSystem::getPath("resources/objects"));
+    }
+
+    std::vector<std::string> images;
+    for (const std::string &input : inputs)
+    {
+        struct stat st;
+        if (stat(input.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+            listFiles(input, isImage, images);
+        else
+            images.push_back(input);
+    }
+
+    int failures = 0;
+    for (const std::string &image : images)
+        if (!bake(image, options))
+            failures++;
+    return failures == 0 ? 0 : 1;
+}